@@ -0,0 +1,114 @@
+/*
+ * BitIO.h
+ *
+ * Bit-level writer/reader used by the Huffman encoder and decoder. Bits are
+ * packed MSB first: the first code ends up in the high bits of the first
+ * payload byte.
+ */
+
+#ifndef BITIO_H
+#define BITIO_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+class BitWriter
+{
+public:
+    // out must have at least 8 writable bytes past the last byte produced:
+    // flush() always stores a whole 64-bit word.
+    explicit BitWriter(unsigned char *out)
+        : p_(out), acc_(0), bits_(0) {}
+
+    // Append the low n bits of value (n may be 0). At most 57 bits may be
+    // pending (including the <= 7 left over by the last flush()) before
+    // flushing.
+    inline void put(uint32_t value, unsigned n)
+    {
+        acc_ |= static_cast<uint64_t>(value) << 1 << (63 - bits_ - n);
+        bits_ += n;
+    }
+
+    // Store the accumulator as one big-endian word and advance by the
+    // number of complete bytes in it; the partial byte stays pending.
+    inline void flush()
+    {
+        uint64_t v = __builtin_bswap64(acc_);
+        std::memcpy(p_, &v, sizeof(v));
+        p_ += bits_ >> 3;
+        acc_ = (bits_ & ~7u) == 64 ? 0 : acc_ << (bits_ & ~7u);
+        bits_ &= 7;
+    }
+
+    // Flush everything, zero-padding the last byte. Returns one past the
+    // last byte written.
+    inline unsigned char *finish()
+    {
+        flush();
+        if (bits_ > 0)
+        {
+            ++p_; // already stored by flush() with zero low bits
+            acc_ = 0;
+            bits_ = 0;
+        }
+        return p_;
+    }
+
+private:
+    unsigned char *p_;
+    uint64_t acc_;
+    unsigned bits_;
+};
+
+class BitReader
+{
+public:
+    BitReader()
+        : p_(nullptr), end_(nullptr), buf_(0), bits_(0) {}
+
+    BitReader(const unsigned char *data, size_t size)
+        : p_(data), end_(data + size), buf_(0), bits_(0) {}
+
+    // Top up the 64-bit window so that at least 56 bits are available
+    // (fewer only at the very end of the input). Past the end, zeros are
+    // shifted in; callers bound decoding with the real bit count.
+    inline void refill()
+    {
+        if (end_ - p_ >= 8)
+        {
+            uint64_t v;
+            std::memcpy(&v, p_, sizeof(v));
+            v = __builtin_bswap64(v); // big-endian: first byte in the top bits
+            buf_ |= v >> bits_;
+            p_ += (63 - bits_) >> 3;
+            bits_ |= 56;
+            return;
+        }
+        while (bits_ <= 56 && p_ < end_)
+        {
+            buf_ |= static_cast<uint64_t>(*p_++) << (56 - bits_);
+            bits_ += 8;
+        }
+    }
+
+    // Look at the next n bits (1 <= n <= 56) without consuming them
+    inline uint32_t peek(unsigned n) const
+    {
+        return static_cast<uint32_t>(buf_ >> (64 - n));
+    }
+
+    inline void consume(unsigned n)
+    {
+        buf_ <<= n;
+        bits_ -= n;
+    }
+
+private:
+    const unsigned char *p_;
+    const unsigned char *end_;
+    uint64_t buf_;
+    unsigned bits_;
+};
+
+#endif // BITIO_H
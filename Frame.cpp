@@ -0,0 +1,302 @@
+#include "Frame.h"
+#include "Varint.h"
+#include <algorithm>
+#include <cstring>
+using namespace std;
+
+namespace
+{
+    const size_t kContainerHeaderBytes = 5;
+    const char kTerminator[2] = {0, 0};
+
+    void appendFrame(vector<char> &out, const char *data, size_t size, const BlockEncodeFn &encode,
+                     vector<char> &body)
+    {
+        body.clear();
+        encode(data, size, body);
+        char header[2 * Varint::kMaxBytes];
+        char *h = Varint::store(header, size);
+        h = Varint::store(h, body.size());
+        out.insert(out.end(), header, h);
+        out.insert(out.end(), body.begin(), body.end());
+    }
+
+    Varint::Status readVarintHeader(const char *base, size_t &pos, size_t end, uint64_t &rawSize,
+                                    uint64_t &bodySize)
+    {
+        size_t p = pos;
+        Varint::Status st = Varint::load(base, p, end, rawSize);
+        if (st == Varint::kOk)
+            st = Varint::load(base, p, end, bodySize);
+        if (st == Varint::kOk)
+            pos = p;
+        return st;
+    }
+
+    // Parse a frame header at base[pos..end); pos advances only on kOk.
+    // A raw size the codec could not have produced is kBad, before
+    // anything is allocated for it.
+    Varint::Status readFrameHeader(const char *base, size_t &pos, size_t end, uint8_t version,
+                                   const FrameHeaderFn &readHeader, unsigned maxExpansion,
+                                   uint64_t &rawSize, uint64_t &bodySize)
+    {
+        size_t p = pos;
+        Varint::Status st = readHeader ? readHeader(base, p, end, version, rawSize, bodySize)
+                                       : readVarintHeader(base, p, end, rawSize, bodySize);
+        if (st != Varint::kOk)
+            return st;
+        bool fits = maxExpansion ? rawSize == 0 || (rawSize - 1) / maxExpansion < bodySize
+                                 : rawSize <= FrameEncoder::kMaxBlockSize;
+        if (!fits)
+            return Varint::kBad;
+        pos = p;
+        return Varint::kOk;
+    }
+
+    // Decode the frames of a whole container of the given size into output.
+    // view(pos, size, copy) makes container[pos..pos+size) readable: into
+    // copy when it is given (headers, which may run into the body), else
+    // where it lies.
+    template <typename View>
+    bool decodeFrames(size_t size, const char magic[4], uint8_t version, const BlockDecodeFn &decode,
+                      vector<char> &output, View view)
+    {
+        output.clear();
+        char header[2 * Varint::kMaxBytes];
+        if (size < kContainerHeaderBytes)
+            return false;
+        const char *h = view(0, kContainerHeaderBytes, header);
+        if (memcmp(h, magic, 4) != 0 || static_cast<uint8_t>(h[4]) != version)
+            return false;
+
+        size_t pos = kContainerHeaderBytes;
+        for (;;)
+        {
+            size_t n = min(sizeof(header), size - pos), p = 0;
+            h = view(pos, n, header);
+            uint64_t rawSize, bodySize;
+            if (readFrameHeader(h, p, n, version, nullptr, 0, rawSize, bodySize) != Varint::kOk)
+                return false;
+            pos += p;
+            if (rawSize == 0)
+                return bodySize == 0 && pos == size;
+            if (bodySize > size - pos)
+                return false;
+            size_t at = output.size();
+            output.resize(at + rawSize);
+            if (!decode(view(pos, bodySize, nullptr), bodySize, output.data() + at, rawSize))
+                return false;
+            pos += bodySize;
+        }
+    }
+}
+
+// ====== Encoder ======
+
+const size_t FrameEncoder::kDefaultBlockSize;
+const size_t FrameEncoder::kMaxBlockSize;
+
+FrameEncoder::FrameEncoder(ByteSink sink, const char magic[4], uint8_t version, size_t blockSize,
+                           BlockEncodeFn encode, unsigned maxExpansion)
+    : sink_(std::move(sink)),
+      blockSize_(blockSize == 0 ? kDefaultBlockSize : maxExpansion ? blockSize : min(blockSize, kMaxBlockSize)),
+      encode_(std::move(encode)),
+      started_(false),
+      finished_(false)
+{
+    memcpy(header_, magic, 4);
+    header_[4] = static_cast<char>(version);
+}
+
+void FrameEncoder::write(const char *data, size_t size)
+{
+    if (!started_)
+    {
+        sink_(header_, sizeof(header_));
+        started_ = true;
+    }
+    while (size > 0)
+    {
+        if (block_.empty() && size >= blockSize_)
+        {
+            // whole block available: encode it in place, without the copy
+            emitBlock(data, blockSize_);
+            data += blockSize_;
+            size -= blockSize_;
+            continue;
+        }
+        // reserved on first use: whole blocks never touch the buffer
+        if (block_.capacity() == 0)
+            block_.reserve(blockSize_);
+        size_t n = min(size, blockSize_ - block_.size());
+        block_.insert(block_.end(), data, data + n);
+        data += n;
+        size -= n;
+        if (block_.size() == blockSize_)
+            flushBlock();
+    }
+}
+
+void FrameEncoder::flushBlock()
+{
+    if (block_.empty())
+        return;
+    emitBlock(block_.data(), block_.size());
+    block_.clear();
+}
+
+void FrameEncoder::emitBlock(const char *data, size_t size)
+{
+    frame_.clear();
+    appendFrame(frame_, data, size, encode_, body_);
+    sink_(frame_.data(), frame_.size());
+}
+
+void FrameEncoder::finish()
+{
+    if (finished_)
+        return;
+    write(nullptr, 0); // emits the container header for empty input
+    flushBlock();
+    sink_(kTerminator, sizeof(kTerminator));
+    finished_ = true;
+}
+
+vector<char> FrameEncoder::encodeAll(const vector<char> &input, const char magic[4], uint8_t version,
+                                     size_t blockSize, const BlockEncodeFn &encode, const RangeFn &done)
+{
+    if (blockSize == 0)
+        blockSize = max<size_t>(input.size(), 1);
+    blockSize = min(blockSize, kMaxBlockSize);
+
+    vector<char> out(magic, magic + 4);
+    out.push_back(static_cast<char>(version));
+    if (done)
+        done(out.data(), out.size(), 0);
+    vector<char> body;
+    for (size_t pos = 0; pos < input.size(); pos += blockSize)
+    {
+        size_t at = out.size();
+        appendFrame(out, input.data() + pos, min(blockSize, input.size() - pos), encode, body);
+        if (done)
+            done(out.data() + at, out.size() - at, at);
+    }
+    size_t at = out.size();
+    out.insert(out.end(), kTerminator, kTerminator + sizeof(kTerminator));
+    if (done)
+        done(out.data() + at, sizeof(kTerminator), at);
+    return out;
+}
+
+// ====== Decoder ======
+
+FrameDecoder::FrameDecoder(ByteSink sink, const char magic[4], uint8_t version, BlockDecodeFn decode,
+                           unsigned maxExpansion, uint8_t minVersion, FrameHeaderFn readHeader)
+    : sink_(std::move(sink)),
+      minVersion_(minVersion == 0 ? version : minVersion),
+      maxVersion_(version),
+      decode_(std::move(decode)),
+      readHeader_(std::move(readHeader)),
+      maxExpansion_(maxExpansion),
+      pos_(0),
+      version_(0),
+      done_(false),
+      failed_(false)
+{
+    memcpy(magic_, magic, 4);
+}
+
+bool FrameDecoder::write(const char *data, size_t size)
+{
+    if (failed_)
+        return false;
+    if (done_)
+    {
+        // nothing may follow the terminator frame
+        failed_ = size > 0;
+        return !failed_;
+    }
+    pending_.insert(pending_.end(), data, data + size);
+    failed_ = !drain();
+    return !failed_;
+}
+
+bool FrameDecoder::drain()
+{
+    const char *base = pending_.data();
+    size_t avail = pending_.size();
+
+    if (version_ == 0)
+    {
+        if (avail - pos_ < kContainerHeaderBytes)
+            return true;
+        uint8_t version = static_cast<uint8_t>(base[pos_ + sizeof(magic_)]);
+        if (memcmp(base + pos_, magic_, sizeof(magic_)) != 0 || version < minVersion_ || version > maxVersion_)
+            return false;
+        pos_ += kContainerHeaderBytes;
+        version_ = version;
+    }
+
+    while (!done_)
+    {
+        size_t bodyPos = pos_;
+        uint64_t rawSize, bodySize;
+        Varint::Status st =
+            readFrameHeader(base, bodyPos, avail, version_, readHeader_, maxExpansion_, rawSize, bodySize);
+        if (st == Varint::kBad)
+            return false;
+        if (st == Varint::kShort)
+            break;
+        if (rawSize == 0)
+        {
+            if (bodySize != 0)
+                return false;
+            pos_ = bodyPos;
+            done_ = true;
+            if (pos_ != avail)
+                return false;
+            break;
+        }
+        if (avail - bodyPos < bodySize)
+            break; // wait for the rest of the block
+
+        out_.resize(rawSize);
+        if (!decode_(base + bodyPos, bodySize, out_.data(), rawSize))
+            return false;
+        sink_(out_.data(), out_.size());
+        pos_ = bodyPos + bodySize;
+    }
+
+    // drop consumed bytes so only one partial frame is ever buffered
+    pending_.erase(pending_.begin(), pending_.begin() + static_cast<ptrdiff_t>(pos_));
+    pos_ = 0;
+    return true;
+}
+
+bool FrameDecoder::finish()
+{
+    return !failed_ && done_;
+}
+
+bool FrameDecoder::decodeAll(const vector<char> &container, const char magic[4], uint8_t version,
+                             const BlockDecodeFn &decode, vector<char> &output)
+{
+    const char *base = container.data();
+    return decodeFrames(container.size(), magic, version, decode, output,
+                        [base](size_t pos, size_t, char *) { return base + pos; });
+}
+
+bool FrameDecoder::decodeAll(vector<char> &container, const char magic[4], uint8_t version,
+                             const BlockDecodeFn &decode, const RangeFn &reveal, vector<char> &output)
+{
+    char *base = container.data();
+    return decodeFrames(container.size(), magic, version, decode, output,
+                        [base, &reveal](size_t pos, size_t size, char *copy) -> const char *
+                        {
+                            char *at = base + pos;
+                            if (copy)
+                                at = static_cast<char *>(memcpy(copy, at, size));
+                            reveal(at, size, pos);
+                            return at;
+                        });
+}
@@ -0,0 +1,141 @@
+/*
+ * Frame.h
+ *
+ * Block framing shared by the streaming Huffman, LZ77 and FSE containers:
+ *
+ *   magic        4 bytes
+ *   version      uint8
+ *   blocks       repeated frame:
+ *     rawSize    varint   uncompressed bytes in the block (0 = terminator)
+ *     bodySize   varint   bytes of the block body that follows
+ *     body       codec-specific
+ *   terminator   frame with rawSize = 0 and bodySize = 0
+ *
+ * The codec only supplies a function that turns a block into a body and
+ * one that turns a body back into the block. FrameEncoder/FrameDecoder
+ * stream the container with memory bounded by one block; encodeAll and
+ * decodeAll handle a whole buffer.
+ *
+ * Before allocating for a block, the decoder bounds its raw size by
+ * FrameEncoder::kMaxBlockSize, or, for a codec that declares one, by its
+ * maximum expansion times the body size (Huffman spends at least one bit
+ * per byte, so its blocks may be any size). A codec with older versions of
+ * its container may also supply the parser of their frame headers.
+ */
+
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include "Varint.h"
+
+// Receives output bytes as they are produced
+using ByteSink = std::function<void(const char *data, size_t size)>;
+// Append the body of block data[0..size) to body (non-empty size)
+using BlockEncodeFn = std::function<void(const char *data, size_t size, std::vector<char> &body)>;
+// Decode body[0..bodySize) into exactly rawSize bytes at out
+using BlockDecodeFn = std::function<bool(const char *body, size_t bodySize, char *out, size_t rawSize)>;
+// Transform data[0..size), which sits at byte pos of a container, in place
+// (e.g. cipher it). Encoders call it on each finished frame so a frame is
+// ciphered while still in cache; decoders call it to reveal each range
+// just before reading it.
+using RangeFn = std::function<void(char *data, size_t size, size_t pos)>;
+// Parse the frame header at base[pos..end) of a container of the given
+// version; pos advances only on kOk
+using FrameHeaderFn = std::function<Varint::Status(const char *base, size_t &pos, size_t end, uint8_t version,
+                                                   uint64_t &rawSize, uint64_t &bodySize)>;
+
+class FrameEncoder
+{
+public:
+    // blockSize 0 = kDefaultBlockSize
+    static const size_t kDefaultBlockSize = size_t(1) << 20;
+    // Largest block a frame may carry unless the codec declares a
+    // maxExpansion. Bigger block sizes are clamped when encoding, and
+    // decoders reject a larger raw size before allocating for it, so a few
+    // crafted header bytes cannot demand gigabytes.
+    static const size_t kMaxBlockSize = size_t(64) << 20;
+
+    // maxExpansion: 0, or the most raw bytes one body byte ever decodes to,
+    // which lifts the kMaxBlockSize limit
+    FrameEncoder(ByteSink sink, const char magic[4], uint8_t version, size_t blockSize,
+                 BlockEncodeFn encode, unsigned maxExpansion = 0);
+
+    void write(const char *data, size_t size);
+
+    // Encode the last partial block and close the container
+    void finish();
+
+    // Whole input at once; blockSize 0 = one block (up to kMaxBlockSize).
+    // done, if set, gets the container header, every frame and the
+    // terminator as soon as each is in place in the output.
+    static std::vector<char> encodeAll(const std::vector<char> &input, const char magic[4],
+                                       uint8_t version, size_t blockSize, const BlockEncodeFn &encode,
+                                       const RangeFn &done = nullptr);
+
+private:
+    void flushBlock();
+    void emitBlock(const char *data, size_t size);
+
+    ByteSink sink_;
+    char header_[5];
+    size_t blockSize_;
+    BlockEncodeFn encode_;
+    std::vector<char> block_;
+    std::vector<char> body_;
+    std::vector<char> frame_;
+    bool started_;
+    bool finished_;
+};
+
+class FrameDecoder
+{
+public:
+    // Accepts versions minVersion..version (minVersion 0 = version only);
+    // readHeader parses their frame headers (null = varint sizes), and
+    // maxExpansion is as in FrameEncoder
+    FrameDecoder(ByteSink sink, const char magic[4], uint8_t version, BlockDecodeFn decode,
+                 unsigned maxExpansion = 0, uint8_t minVersion = 0, FrameHeaderFn readHeader = nullptr);
+
+    // Version of the container, 0 until its header has been read
+    uint8_t version() const { return version_; }
+
+    // Returns false once the input is known to be malformed
+    bool write(const char *data, size_t size);
+
+    // True if the whole container, terminator included, was decoded
+    bool finish();
+
+    // Whole container at once; returns false if it is malformed
+    static bool decodeAll(const std::vector<char> &container, const char magic[4], uint8_t version,
+                          const BlockDecodeFn &decode, std::vector<char> &output);
+
+    // Same for a container whose bytes are still transformed (e.g.
+    // encrypted): reveal undoes that one frame at a time, each body in
+    // place right before it is decoded. Headers are revealed in a copy, so
+    // the container is left only partly revealed.
+    static bool decodeAll(std::vector<char> &container, const char magic[4], uint8_t version,
+                          const BlockDecodeFn &decode, const RangeFn &reveal, std::vector<char> &output);
+
+private:
+    bool drain();
+
+    ByteSink sink_;
+    char magic_[4];
+    uint8_t minVersion_;
+    uint8_t maxVersion_;
+    BlockDecodeFn decode_;
+    FrameHeaderFn readHeader_;
+    unsigned maxExpansion_;
+    std::vector<char> pending_; // undecoded input, at most one frame
+    std::vector<char> out_;     // decoded block, reused
+    size_t pos_;
+    uint8_t version_;
+    bool done_;
+    bool failed_;
+};
+
+#endif // FRAME_H
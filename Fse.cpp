@@ -0,0 +1,541 @@
+#include "Fse.h"
+#include "BitIO.h"
+#include "Histogram.h"
+#include "Varint.h"
+#include <algorithm>
+#include <cstring>
+using namespace std;
+
+namespace
+{
+    const char kMagic[4] = {'F', 'S', 'E', 'V'};
+    const uint8_t kFormatVersion = 1;
+
+    // Block kinds
+    const uint8_t kBlockFse = 0;
+    const uint8_t kBlockStored = 1;
+    const uint8_t kBlockRepeat = 2;
+
+    // Blocks whose entropy saves less than 1/128 of the raw size are stored
+    const unsigned kStoredGainShift = 7;
+
+    const size_t kMaxStates = size_t(1) << Fse::kMaxTableLog;
+
+    inline unsigned highBit(uint64_t v)
+    {
+        return 63 - __builtin_clzll(v);
+    }
+
+    // Table size for a block of size bytes using `symbols` distinct values:
+    // small blocks do not have the statistics to fill a large table, and
+    // the table must have at least one state per symbol
+    unsigned chooseTableLog(size_t size, unsigned symbols)
+    {
+        unsigned log = Fse::kDefaultTableLog;
+        unsigned sourceBits = highBit(size - 1);
+        if (sourceBits >= 2 && sourceBits - 2 < log)
+            log = sourceBits - 2;
+        unsigned minBits = min(sourceBits + 1, highBit(symbols) + 2);
+        log = max(log, minBits);
+        const unsigned lo = Fse::kMinTableLog, hi = Fse::kMaxTableLog;
+        return min(max(log, lo), hi);
+    }
+
+    // Scale freq to integer counts summing to 2^tableLog. Every present
+    // byte keeps at least 1; the rounding deficit goes to the largest
+    // fractional parts and any excess comes off the largest counts.
+    void normalizeCounts(const uint64_t freq[256], uint64_t total, unsigned tableLog, uint32_t norm[256])
+    {
+        const uint64_t states = uint64_t(1) << tableLog;
+        uint64_t rem[256];
+        unsigned order[256], used = 0;
+        uint64_t sum = 0;
+        for (unsigned s = 0; s < 256; ++s)
+        {
+            norm[s] = 0;
+            if (freq[s] == 0)
+                continue;
+            uint64_t scaled = freq[s] * states;
+            norm[s] = static_cast<uint32_t>(max<uint64_t>(scaled / total, 1));
+            rem[s] = scaled / total == 0 ? 0 : scaled % total;
+            sum += norm[s];
+            order[used++] = s;
+        }
+
+        stable_sort(order, order + used, [&](unsigned x, unsigned y)
+                    { return rem[x] > rem[y]; });
+        for (unsigned i = 0; sum < states; i = (i + 1) % used, ++sum)
+            norm[order[i]]++;
+
+        while (sum > states)
+        {
+            unsigned big = order[0];
+            for (unsigned i = 1; i < used; ++i)
+            {
+                if (norm[order[i]] > norm[big] || (norm[order[i]] == norm[big] && order[i] < big))
+                    big = order[i];
+            }
+            norm[big]--;
+            sum--;
+        }
+    }
+
+    // Scatter the states of each byte over the table. The step is odd, so
+    // it visits every slot once, and it spreads a byte's states apart.
+    void spreadSymbols(const uint32_t norm[256], unsigned maxSymbol, unsigned tableLog, uint8_t table[])
+    {
+        const size_t mask = (size_t(1) << tableLog) - 1;
+        const size_t step = (mask >> 1) + (mask >> 3) + 3;
+        size_t pos = 0;
+        for (unsigned s = 0; s <= maxSymbol; ++s)
+        {
+            for (uint32_t k = 0; k < norm[s]; ++k)
+            {
+                table[pos] = static_cast<uint8_t>(s);
+                pos = (pos + step) & mask;
+            }
+        }
+    }
+
+    // Encoder state lives in [2^tableLog, 2^(tableLog+1)). For each byte,
+    // deltaNbBits turns the state into the number of bits to emit with one
+    // add and shift, and deltaFindState locates the next state.
+    class EncodeTable
+    {
+    public:
+        void build(const uint32_t norm[256], unsigned maxSymbol, unsigned tableLog)
+        {
+            const uint32_t states = uint32_t(1) << tableLog;
+            uint8_t spread[kMaxStates];
+            spreadSymbols(norm, maxSymbol, tableLog, spread);
+
+            uint32_t cumul[257];
+            cumul[0] = 0;
+            for (unsigned s = 0; s < 256; ++s)
+                cumul[s + 1] = cumul[s] + (s <= maxSymbol ? norm[s] : 0);
+            for (uint32_t u = 0; u < states; ++u)
+                next_[cumul[spread[u]]++] = static_cast<uint16_t>(states + u);
+
+            uint32_t total = 0;
+            for (unsigned s = 0; s <= maxSymbol; ++s)
+            {
+                Symbol &e = symbols_[s];
+                if (norm[s] == 0)
+                    continue;
+                if (norm[s] == 1)
+                {
+                    e.deltaNbBits = (tableLog << 16) - states;
+                    e.deltaFindState = static_cast<int32_t>(total) - 1;
+                }
+                else
+                {
+                    uint32_t maxBitsOut = tableLog - highBit(norm[s] - 1);
+                    uint32_t minStatePlus = norm[s] << maxBitsOut;
+                    e.deltaNbBits = (maxBitsOut << 16) - minStatePlus;
+                    e.deltaFindState = static_cast<int32_t>(total) - static_cast<int32_t>(norm[s]);
+                }
+                total += norm[s];
+            }
+        }
+
+        // Emit the bits that byte s takes out of state and move to the
+        // state that encodes s. Returns the number of bits emitted.
+        inline unsigned put(BitWriter &w, uint32_t &state, unsigned char s) const
+        {
+            const Symbol &e = symbols_[s];
+            unsigned nb = (state + e.deltaNbBits) >> 16;
+            w.put(state & ((1u << nb) - 1), nb);
+            state = next_[(state >> nb) + e.deltaFindState];
+            return nb;
+        }
+
+    private:
+        struct Symbol
+        {
+            int32_t deltaFindState;
+            uint32_t deltaNbBits;
+        };
+        Symbol symbols_[256];
+        uint16_t next_[kMaxStates];
+    };
+
+    struct DecodeEntry
+    {
+        uint16_t newState; // next state before adding the bits read
+        uint8_t symbol;
+        uint8_t nbBits;
+    };
+
+    void buildDecodeTable(const uint32_t norm[256], unsigned maxSymbol, unsigned tableLog, DecodeEntry table[])
+    {
+        const uint32_t states = uint32_t(1) << tableLog;
+        uint8_t spread[kMaxStates];
+        spreadSymbols(norm, maxSymbol, tableLog, spread);
+
+        uint32_t next[256];
+        copy(norm, norm + 256, next);
+        for (uint32_t u = 0; u < states; ++u)
+        {
+            uint32_t x = next[spread[u]]++;
+            unsigned nb = tableLog - highBit(x);
+            table[u].symbol = spread[u];
+            table[u].nbBits = static_cast<uint8_t>(nb);
+            table[u].newState = static_cast<uint16_t>((x << nb) - states);
+        }
+    }
+
+    // Reads the payload from its last bit back to its first, the reverse of
+    // the order the encoder wrote it. reload() loads the 64 bits ending at
+    // the current position; up to 57 bits may then be read before the next
+    // reload.
+    class BackwardReader
+    {
+    public:
+        BackwardReader()
+            : data_(nullptr), total_(0), used_(0), window_(0), shift_(0), start_(0) {}
+
+        BackwardReader(const unsigned char *data, size_t totalBits)
+            : data_(data), total_(totalBits), used_(0), window_(0), shift_(0), start_(0) {}
+
+        // False once more bits were read than the payload holds
+        inline bool reload()
+        {
+            used_ += shift_ - start_;
+            if (used_ > total_)
+                return false;
+            size_t end = total_ - used_;
+            size_t byte = (end + 7) >> 3;
+            if (byte >= 8)
+            {
+                uint64_t v;
+                memcpy(&v, data_ + byte - 8, sizeof(v));
+                window_ = __builtin_bswap64(v);
+            }
+            else
+            {
+                window_ = 0;
+                for (size_t k = 0; k < byte; ++k)
+                    window_ = (window_ << 8) | data_[k];
+            }
+            shift_ = start_ = static_cast<unsigned>(byte * 8 - end);
+            return true;
+        }
+
+        inline uint32_t read(unsigned n)
+        {
+            uint32_t v = static_cast<uint32_t>((window_ >> shift_) & ((uint64_t(1) << n) - 1));
+            shift_ += n;
+            return v;
+        }
+
+        // True if exactly every payload bit was read
+        bool finished() const
+        {
+            return used_ + (shift_ - start_) == total_;
+        }
+
+    private:
+        const unsigned char *data_;
+        size_t total_;
+        size_t used_;
+        uint64_t window_;
+        unsigned shift_;
+        unsigned start_;
+    };
+
+    // Byte range of sub-stream i in a block of size bytes
+    inline void streamRange(size_t size, unsigned i, size_t &begin, size_t &end)
+    {
+        size_t seg = (size + Fse::kStreams - 1) / Fse::kStreams;
+        begin = min(size, i * seg);
+        end = min(size, begin + seg);
+    }
+
+    void appendStored(const char *data, size_t size, vector<char> &body)
+    {
+        body.push_back(static_cast<char>(kBlockStored));
+        body.insert(body.end(), data, data + size);
+    }
+
+    // Encode every sub-stream back to front, so the decoder runs front to
+    // back, one state per sub-stream. The bytes past the last full round
+    // of the shortest sub-stream go first, on their own; then all
+    // sub-streams advance together, mirroring the decoder. Four puts of at
+    // most kMaxTableLog bits fit between flushes.
+    void encodeStreams(const EncodeTable &table, unsigned tableLog, const unsigned char *p, size_t size,
+                       unsigned char *const out[], size_t payloadBytes[], unsigned pads[])
+    {
+        static_assert(Fse::kStreams == 4, "one writer per sub-stream");
+        const uint32_t states = uint32_t(1) << tableLog;
+        BitWriter w[Fse::kStreams] = {BitWriter(out[0]), BitWriter(out[1]), BitWriter(out[2]), BitWriter(out[3])};
+        uint32_t state[Fse::kStreams];
+        uint64_t bits[Fse::kStreams];
+        const unsigned char *in[Fse::kStreams];
+        size_t begin, end;
+        streamRange(size, Fse::kStreams - 1, begin, end);
+        const size_t rounds = (end - begin) / 4;
+
+        for (unsigned k = 0; k < Fse::kStreams; ++k)
+        {
+            streamRange(size, k, begin, end);
+            in[k] = p + begin;
+            state[k] = states;
+            bits[k] = tableLog;
+            for (size_t i = end - begin; i > rounds * 4; --i)
+            {
+                bits[k] += table.put(w[k], state[k], in[k][i - 1]);
+                if (i % 4 == 1)
+                    w[k].flush();
+            }
+            w[k].flush();
+        }
+
+        for (size_t i = rounds * 4; i > 0; i -= 4)
+        {
+            for (unsigned j = 1; j <= 4; ++j)
+            {
+#pragma GCC unroll 4
+                for (unsigned k = 0; k < Fse::kStreams; ++k)
+                    bits[k] += table.put(w[k], state[k], in[k][i - j]);
+            }
+#pragma GCC unroll 4
+            for (unsigned k = 0; k < Fse::kStreams; ++k)
+                w[k].flush();
+        }
+
+        for (unsigned k = 0; k < Fse::kStreams; ++k)
+        {
+            w[k].put(state[k] - states, tableLog);
+            pads[k] = static_cast<unsigned>((8 - bits[k] % 8) % 8);
+            payloadBytes[k] = static_cast<size_t>(w[k].finish() - out[k]);
+        }
+    }
+
+    void encodeBlock(const char *data, size_t size, vector<char> &body)
+    {
+        const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+        const size_t start = body.size();
+        uint64_t freq[256];
+        // blocks are encoded on pool workers already: one thread each
+        Histogram::count(p, size, freq, 1);
+
+        unsigned maxSymbol = 0, symbols = 0;
+        for (unsigned s = 0; s < 256; ++s)
+        {
+            if (freq[s] > 0)
+            {
+                maxSymbol = s;
+                symbols++;
+            }
+        }
+        if (symbols == 1)
+        {
+            body.push_back(static_cast<char>(kBlockRepeat));
+            body.push_back(data[0]);
+            return;
+        }
+        const double rawBits = 8.0 * size;
+        if (Histogram::entropyBits(freq) >= rawBits - rawBits / (1u << kStoredGainShift))
+        {
+            appendStored(data, size, body);
+            return;
+        }
+
+        const unsigned tableLog = chooseTableLog(size, symbols);
+        uint32_t norm[256];
+        normalizeCounts(freq, size, tableLog, norm);
+        EncodeTable table;
+        table.build(norm, maxSymbol, tableLog);
+
+        body.push_back(static_cast<char>(kBlockFse));
+        body.push_back(static_cast<char>(tableLog));
+        body.push_back(static_cast<char>(maxSymbol));
+        char buf[Varint::kMaxBytes];
+        for (unsigned s = 0; s <= maxSymbol; ++s)
+            body.insert(body.end(), buf, Varint::store(buf, norm[s]));
+
+        // each sub-stream goes to its own scratch buffer first, since the
+        // sizes precede the payloads; every byte costs at most tableLog bits
+        // and flush() may store 8 bytes past the end
+        static thread_local vector<unsigned char> scratch[Fse::kStreams];
+        unsigned char *out[Fse::kStreams];
+        size_t payloadBytes[Fse::kStreams];
+        unsigned pads[Fse::kStreams];
+        for (unsigned k = 0; k < Fse::kStreams; ++k)
+        {
+            size_t begin, end;
+            streamRange(size, k, begin, end);
+            scratch[k].resize(((end - begin) * tableLog + tableLog) / 8 + 1 + 8);
+            out[k] = scratch[k].data();
+        }
+        encodeStreams(table, tableLog, p, size, out, payloadBytes, pads);
+
+        for (unsigned k = 0; k < Fse::kStreams; ++k)
+            body.push_back(static_cast<char>(pads[k]));
+        for (unsigned k = 0; k + 1 < Fse::kStreams; ++k)
+            body.insert(body.end(), buf, Varint::store(buf, payloadBytes[k]));
+        for (unsigned k = 0; k < Fse::kStreams; ++k)
+            body.insert(body.end(), scratch[k].begin(), scratch[k].begin() + payloadBytes[k]);
+
+        if (body.size() - start >= 1 + size)
+        {
+            body.resize(start);
+            appendStored(data, size, body);
+        }
+    }
+
+    bool decodeBody(const char *base, size_t end, char *out, size_t rawSize)
+    {
+        if (end == 0)
+            return false;
+        const uint8_t kind = static_cast<uint8_t>(base[0]);
+        if (kind == kBlockStored)
+        {
+            if (end - 1 != rawSize)
+                return false;
+            memcpy(out, base + 1, rawSize);
+            return true;
+        }
+        if (kind == kBlockRepeat)
+        {
+            if (end != 2)
+                return false;
+            memset(out, base[1], rawSize);
+            return true;
+        }
+        if (kind != kBlockFse || end < 3)
+            return false;
+
+        const unsigned tableLog = static_cast<uint8_t>(base[1]);
+        const unsigned maxSymbol = static_cast<uint8_t>(base[2]);
+        if (tableLog < Fse::kMinTableLog || tableLog > Fse::kMaxTableLog)
+            return false;
+        const uint32_t states = uint32_t(1) << tableLog;
+
+        uint32_t norm[256] = {};
+        uint64_t sum = 0;
+        size_t pos = 3;
+        for (unsigned s = 0; s <= maxSymbol; ++s)
+        {
+            uint64_t v;
+            if (Varint::load(base, pos, end, v) != Varint::kOk || v > states)
+                return false;
+            norm[s] = static_cast<uint32_t>(v);
+            sum += v;
+        }
+        if (sum != states || end - pos < Fse::kStreams)
+            return false;
+
+        unsigned pads[Fse::kStreams];
+        for (unsigned k = 0; k < Fse::kStreams; ++k)
+        {
+            pads[k] = static_cast<uint8_t>(base[pos++]);
+            if (pads[k] > 7)
+                return false;
+        }
+        size_t payloadBytes[Fse::kStreams];
+        size_t left = end;
+        for (unsigned k = 0; k + 1 < Fse::kStreams; ++k)
+        {
+            uint64_t n;
+            if (Varint::load(base, pos, end, n) != Varint::kOk)
+                return false;
+            payloadBytes[k] = static_cast<size_t>(n);
+        }
+        left -= pos;
+
+        DecodeEntry table[kMaxStates];
+        buildDecodeTable(norm, maxSymbol, tableLog, table);
+
+        BackwardReader br[Fse::kStreams];
+        uint32_t state[Fse::kStreams];
+        char *o[Fse::kStreams];
+        size_t count[Fse::kStreams];
+        const unsigned char *payload = reinterpret_cast<const unsigned char *>(base + pos);
+        for (unsigned k = 0; k < Fse::kStreams; ++k)
+        {
+            if (k + 1 == Fse::kStreams)
+                payloadBytes[k] = left;
+            if (payloadBytes[k] > left || (payloadBytes[k] == 0 && pads[k] > 0))
+                return false;
+            left -= payloadBytes[k];
+            br[k] = BackwardReader(payload, payloadBytes[k] * 8 - pads[k]);
+            payload += payloadBytes[k];
+
+            size_t begin, stop;
+            streamRange(rawSize, k, begin, stop);
+            o[k] = out + begin;
+            count[k] = stop - begin;
+            if (!br[k].reload())
+                return false;
+            state[k] = br[k].read(tableLog);
+        }
+
+        // Rounds of four lookups per stream, one reload each: 4 *
+        // kMaxTableLog + 7 bits fit the window. The last stream is the
+        // shortest, so it bounds the rounds.
+        const size_t rounds = count[Fse::kStreams - 1] / 4;
+        for (size_t r = 0; r < rounds; ++r)
+        {
+            bool ok = true;
+#pragma GCC unroll 4
+            for (unsigned k = 0; k < Fse::kStreams; ++k)
+                ok &= br[k].reload();
+            if (!ok)
+                return false;
+#pragma GCC unroll 4
+            for (unsigned j = 0; j < 4; ++j)
+            {
+#pragma GCC unroll 4
+                for (unsigned k = 0; k < Fse::kStreams; ++k)
+                {
+                    const DecodeEntry e = table[state[k]];
+                    *o[k]++ = static_cast<char>(e.symbol);
+                    state[k] = e.newState + br[k].read(e.nbBits);
+                }
+            }
+        }
+
+        for (unsigned k = 0; k < Fse::kStreams; ++k)
+        {
+            for (size_t i = rounds * 4; i < count[k]; ++i)
+            {
+                if (!br[k].reload())
+                    return false;
+                const DecodeEntry e = table[state[k]];
+                *o[k]++ = static_cast<char>(e.symbol);
+                state[k] = e.newState + br[k].read(e.nbBits);
+            }
+            // the encoder started from state 0: anything else means the
+            // payload does not belong to these counts
+            if (!br[k].reload() || !br[k].finished() || state[k] != 0)
+                return false;
+        }
+        return true;
+    }
+}
+
+vector<char> Fse::compress(const vector<char> &input, size_t blockSize, const RangeFn &done)
+{
+    return FrameEncoder::encodeAll(input, kMagic, kFormatVersion, blockSize, encodeBlock, done);
+}
+
+bool Fse::decompress(const vector<char> &compressed, vector<char> &output)
+{
+    return FrameDecoder::decodeAll(compressed, kMagic, kFormatVersion, decodeBody, output);
+}
+
+bool Fse::decompress(vector<char> &compressed, const RangeFn &reveal, vector<char> &output)
+{
+    return FrameDecoder::decodeAll(compressed, kMagic, kFormatVersion, decodeBody, reveal, output);
+}
+
+FseEncoder::FseEncoder(ByteSink sink, size_t blockSize)
+    : frames_(std::move(sink), kMagic, kFormatVersion, blockSize, encodeBlock)
+{
+}
+
+FseDecoder::FseDecoder(ByteSink sink)
+    : frames_(std::move(sink), kMagic, kFormatVersion, decodeBody)
+{
+}
@@ -0,0 +1,98 @@
+/*
+ * Fse.h
+ *
+ * Table-based asymmetric numeral system (tANS, "finite state entropy")
+ * coder, an alternative to the Huffman backend. Symbol frequencies are
+ * normalized to a power of two 2^tableLog and spread over a state table;
+ * a symbol of probability p then costs close to -log2(p) bits, fractions
+ * included, instead of a whole-bit code length. This pays off on skewed
+ * distributions where Huffman rounds the most frequent symbol up to 1 bit.
+ *
+ * Decoding is one table lookup per symbol (symbol, bits to read, next
+ * state base) with no data-dependent branches. Each block is split into
+ * kStreams segments, each with its own state and bitstream, and the
+ * decoder advances all of them in the same loop so their serial
+ * state-to-state dependency chains overlap.
+ *
+ * Container: the block framing of Frame.h with magic "FSEV". Block body:
+ *       kind         uint8    0 = FSE, 1 = stored, 2 = single repeated byte
+ *   kind 1: the raw block
+ *   kind 2: the byte
+ *   kind 0:
+ *       tableLog     uint8    kMinTableLog..kMaxTableLog
+ *       maxSymbol    uint8    highest byte value present
+ *       counts       varint   normalized count of bytes 0..maxSymbol, sum 2^tableLog
+ *       pads         kStreams x uint8, zero bits at the end of each payload
+ *       sizes        (kStreams - 1) x varint, payload bytes of each sub-stream
+ *                    but the last
+ *       payloads     one bitstream per sub-stream, read back to front by the
+ *                    decoder. Sub-stream i covers bytes [i*seg, (i+1)*seg) of
+ *                    the block, seg = ceil(rawSize / kStreams).
+ */
+
+#ifndef FSE_H
+#define FSE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "Frame.h"
+
+class Fse
+{
+public:
+    // 2^tableLog states. Larger tables follow the histogram more closely
+    // but cost more to build and put more pressure on the L1 cache.
+    static const unsigned kMinTableLog = 5;
+    static const unsigned kMaxTableLog = 12;
+    static const unsigned kDefaultTableLog = 11;
+    // Independent state/bitstream pairs per block
+    static const unsigned kStreams = 4;
+
+    // blockSize 0 = whole input as one block; blocks are at most
+    // FrameEncoder::kMaxBlockSize. done, if set, gets each finished frame
+    // (see FrameEncoder::encodeAll).
+    static std::vector<char> compress(const std::vector<char> &input, size_t blockSize = 0,
+                                      const RangeFn &done = nullptr);
+
+    // Decompress into output; returns false if the container is malformed
+    // (output is unspecified then)
+    static bool decompress(const std::vector<char> &compressed, std::vector<char> &output);
+    // Same for a still-transformed container, revealed frame by frame in
+    // place (see FrameDecoder::decodeAll)
+    static bool decompress(std::vector<char> &compressed, const RangeFn &reveal, std::vector<char> &output);
+};
+
+// Streaming compressor with the same interface as HuffmanEncoder
+class FseEncoder
+{
+public:
+    // blockSize 0 = FrameEncoder::kDefaultBlockSize
+    explicit FseEncoder(ByteSink sink, size_t blockSize = FrameEncoder::kDefaultBlockSize);
+
+    void write(const char *data, size_t size) { frames_.write(data, size); }
+
+    // Compress the last partial block and close the container
+    void finish() { frames_.finish(); }
+
+private:
+    FrameEncoder frames_;
+};
+
+// Streaming decompressor with the same interface as HuffmanDecoder
+class FseDecoder
+{
+public:
+    explicit FseDecoder(ByteSink sink);
+
+    // Returns false once the input is known to be malformed
+    bool write(const char *data, size_t size) { return frames_.write(data, size); }
+
+    // True if the whole container, terminator included, was decoded
+    bool finish() { return frames_.finish(); }
+
+private:
+    FrameDecoder frames_;
+};
+
+#endif // FSE_H
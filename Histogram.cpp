@@ -0,0 +1,116 @@
+#include "Histogram.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <vector>
+using namespace std;
+
+namespace
+{
+    // 32-bit sub-counters are flushed before they can overflow
+    const size_t kChunk = size_t(1) << 30;
+}
+
+void Histogram::countSerial(const unsigned char *data, size_t size, uint64_t freq[256])
+{
+    memset(freq, 0, 256 * sizeof(uint64_t));
+
+    while (size > 0)
+    {
+        size_t n = min(size, kChunk);
+        uint32_t c0[256] = {}, c1[256] = {}, c2[256] = {}, c3[256] = {};
+        const unsigned char *p = data;
+        const unsigned char *end = data + n;
+
+        // 8 bytes per load, spread round-robin over the four tables
+        while (end - p >= 8)
+        {
+            uint64_t w;
+            memcpy(&w, p, sizeof(w));
+            p += 8;
+            c0[w & 0xFF]++;
+            c1[(w >> 8) & 0xFF]++;
+            c2[(w >> 16) & 0xFF]++;
+            c3[(w >> 24) & 0xFF]++;
+            c0[(w >> 32) & 0xFF]++;
+            c1[(w >> 40) & 0xFF]++;
+            c2[(w >> 48) & 0xFF]++;
+            c3[w >> 56]++;
+        }
+        while (p < end)
+        {
+            c0[*p++]++;
+        }
+
+        for (int s = 0; s < 256; ++s)
+        {
+            freq[s] += uint64_t(c0[s]) + c1[s] + c2[s] + c3[s];
+        }
+        data += n;
+        size -= n;
+    }
+}
+
+void Histogram::countNaive(const unsigned char *data, size_t size, uint64_t freq[256])
+{
+    memset(freq, 0, 256 * sizeof(uint64_t));
+    for (size_t i = 0; i < size; ++i)
+    {
+        freq[data[i]]++;
+    }
+}
+
+double Histogram::entropyBits(const uint64_t freq[256])
+{
+    uint64_t total = 0;
+    for (int s = 0; s < 256; ++s)
+        total += freq[s];
+    if (total == 0)
+        return 0;
+
+    // sum f * log2(total / f)
+    double bits = 0;
+    double logTotal = log2(static_cast<double>(total));
+    for (int s = 0; s < 256; ++s)
+    {
+        if (freq[s] > 0)
+            bits += freq[s] * (logTotal - log2(static_cast<double>(freq[s])));
+    }
+    return bits;
+}
+
+void Histogram::count(const unsigned char *data, size_t size, uint64_t freq[256], unsigned maxThreads)
+{
+    unsigned threads = maxThreads ? maxThreads : thread::hardware_concurrency();
+    if (threads == 0)
+        threads = 1;
+    // give every thread at least half the threshold worth of bytes
+    threads = static_cast<unsigned>(min<size_t>(threads, size / (kParallelThreshold / 2)));
+
+    if (size < kParallelThreshold || threads <= 1)
+    {
+        countSerial(data, size, freq);
+        return;
+    }
+
+    vector<uint64_t> partial(size_t(threads) * 256);
+    vector<thread> pool;
+    size_t slice = size / threads;
+    for (unsigned t = 0; t < threads; ++t)
+    {
+        size_t begin = t * slice;
+        size_t n = (t + 1 == threads) ? size - begin : slice;
+        pool.emplace_back([=, &partial]
+                          { countSerial(data + begin, n, &partial[size_t(t) * 256]); });
+    }
+    for (auto &th : pool)
+        th.join();
+
+    memset(freq, 0, 256 * sizeof(uint64_t));
+    for (unsigned t = 0; t < threads; ++t)
+    {
+        for (int s = 0; s < 256; ++s)
+            freq[s] += partial[size_t(t) * 256 + s];
+    }
+}
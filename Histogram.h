@@ -0,0 +1,41 @@
+/*
+ * Histogram.h
+ *
+ * Byte histogram used by the Huffman frequency pass. Counts go into a flat
+ * 256-bin array instead of searching a symbol list per input byte.
+ *
+ * The kernel keeps four interleaved sub-histograms so consecutive equal
+ * bytes do not serialize on the same counter (store-to-load forwarding
+ * stalls), reads the input a 64-bit word at a time, and splits large
+ * inputs across threads before merging the partial counts.
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <cstddef>
+#include <cstdint>
+
+class Histogram
+{
+public:
+    // Inputs at least this large are counted on several threads
+    static const size_t kParallelThreshold = size_t(16) << 20;
+
+    // Count every byte of data[0..size) into freq (overwritten).
+    // maxThreads = 0 uses std::thread::hardware_concurrency().
+    static void count(const unsigned char *data, size_t size, uint64_t freq[256],
+                      unsigned maxThreads = 0);
+
+    // Single-threaded kernel, also used by each thread of count()
+    static void countSerial(const unsigned char *data, size_t size, uint64_t freq[256]);
+
+    // Reference implementation: one counter, one byte at a time
+    static void countNaive(const unsigned char *data, size_t size, uint64_t freq[256]);
+
+    // Shannon entropy of the counts, in bits for all of them together: a
+    // lower bound for the payload of any per-byte prefix code.
+    static double entropyBits(const uint64_t freq[256]);
+};
+
+#endif // HISTOGRAM_H
@@ -1,286 +1,913 @@
 #include "Huffman.h"
-#include "NodeLetter.h"
-#include <map>
+#include "Histogram.h"
+#include "Stats.h"
+#include "Varint.h"
 #include <algorithm>
-#include <utility>
+#include <atomic>
 #include <iostream>
 #include <fstream>
+#include <thread>
 #include <cstdint>
+#include <cstring>
 using namespace std;
 
-
-std::vector<char> Huffman::HuffmanCompression(const std::vector<char> &input)
+namespace
 {
-    // Minimal stub for integration: compute frequencies (example) and
-    // return the input as-is. Replace this with a real Huffman encoder.
-    vector<pair<char, int>> frequency;
+    // Container identification
+    const char kMagic[4] = {'H', 'U', 'F', 'V'};
+    const uint8_t kVersionSingle = 2;  // one implicit block, payload to the end
+    const uint8_t kVersionFrames32 = 3; // framed blocks, uint32 frame header
+    const uint8_t kVersionVarint = 4;   // framed blocks, varint frame header
+    const uint8_t kFormatVersion = 5;   // version 4 plus sub-streams per block
+    const size_t kContainerHeaderBytes = sizeof(kMagic) + 1;
+
+    // Code-length table encodings
+    const uint8_t kTableEmpty = 0;  // no symbols (empty input)
+    const uint8_t kTableSparse = 1; // count-1, then (symbol, length) pairs
+    const uint8_t kTableDense = 2;  // 256 lengths packed two per byte
+    const uint8_t kTableStored = 3; // no code: the raw bytes follow
+    const uint8_t kTableDict = 4;   // uint32 dictionary ID instead of lengths
+    const size_t kDictRefBytes = 5;
+    const size_t kDenseTableBytes = 128;
+
+    // Blocks whose entropy leaves less than 1/128 of the raw size to gain
+    // are stored without building a code
+    const unsigned kStoredGainShift = 7;
+
+    // Block frame header: rawSize + bodySize, as two uint32 (version 3) or
+    // two varints (version 4)
+    const size_t kFrameHeader32Bytes = 8;
+    const char kTerminator[2] = {0, 0};
+
+    // Every byte costs at least one bit, and a stored block one byte, so no
+    // body decodes to more than 8 raw bytes per byte
+    const unsigned kMaxExpansion = 8;
+
+    // Dictionary file identification
+    const char kDictMagic[4] = {'H', 'U', 'F', 'D'};
+    const uint8_t kDictVersion = 1;
+
+    // Little-endian, so version 2/3 containers are portable between hosts
+    uint32_t loadU32(const char *in)
+    {
+        uint32_t v = 0;
+        for (int i = 0; i < 4; ++i)
+            v |= static_cast<uint32_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+        return v;
+    }
+
+    void storeU32(char *out, uint32_t v)
+    {
+        for (int i = 0; i < 4; ++i)
+            out[i] = static_cast<char>(v >> (8 * i));
+    }
+
+    // Parse the rawSize/bodySize frame header at base[pos..end)
+    Varint::Status readFrameHeader(const char *base, size_t &pos, size_t end, uint8_t version,
+                                uint64_t &rawSize, uint64_t &bodySize)
+    {
+        if (version == kVersionFrames32)
+        {
+            if (end - pos < kFrameHeader32Bytes)
+                return Varint::kShort;
+            rawSize = loadU32(base + pos);
+            bodySize = loadU32(base + pos + 4);
+            pos += kFrameHeader32Bytes;
+            return Varint::kOk;
+        }
+        size_t p = pos;
+        Varint::Status st = Varint::load(base, p, end, rawSize);
+        if (st == Varint::kOk)
+            st = Varint::load(base, p, end, bodySize);
+        if (st == Varint::kOk)
+            pos = p;
+        return st;
+    }
+
+    bool isFramedVersion(uint8_t version)
+    {
+        return version == kVersionFrames32 || version == kVersionVarint || version == kFormatVersion;
+    }
 
-    // Calculate frequency of each character
-    for (char c : input)
+    // Sub-stream i of a block covers raw bytes [i * seg, (i + 1) * seg)
+    // clipped to the block, with seg = ceil(rawSize / streams)
+    size_t streamSegment(size_t rawSize, unsigned streams)
     {
-        bool found = false;
-        for (auto &pair : frequency)
+        return (rawSize + streams - 1) / streams;
+    }
+
+    // Run fn(0..count-1) on up to `threads` threads (0 = one per core)
+    template <typename Fn>
+    void parallelFor(size_t count, unsigned threads, Fn fn)
+    {
+        if (threads == 0)
+            threads = max(1u, thread::hardware_concurrency());
+        threads = static_cast<unsigned>(min<size_t>(threads, count));
+        if (threads <= 1)
+        {
+            for (size_t i = 0; i < count; ++i)
+                fn(i);
+            return;
+        }
+        atomic<size_t> next{0};
+        vector<thread> pool;
+        for (unsigned t = 0; t < threads; ++t)
+        {
+            pool.emplace_back([&]
+                              {
+                for (size_t i; (i = next++) < count;)
+                    fn(i); });
+        }
+        for (auto &th : pool)
+            th.join();
+    }
+
+    void writeCodeLengths(vector<char> &out, const uint8_t lengths[256])
+    {
+        int count = 0;
+        for (int s = 0; s < 256; ++s)
+        {
+            if (lengths[s] != 0)
+                count++;
+        }
+
+        if (count == 0)
         {
-            if (pair.first == c)
+            out.push_back(static_cast<char>(kTableEmpty));
+            return;
+        }
+
+        // pairs cost 2 bytes per symbol, the dense form a fixed 128 bytes
+        if (1 + 2 * static_cast<size_t>(count) < kDenseTableBytes)
+        {
+            out.push_back(static_cast<char>(kTableSparse));
+            out.push_back(static_cast<char>(count - 1));
+            for (int s = 0; s < 256; ++s)
             {
-                pair.second++;
-                found = true;
-                break;
+                if (lengths[s] == 0)
+                    continue;
+                out.push_back(static_cast<char>(s));
+                out.push_back(static_cast<char>(lengths[s]));
             }
+            return;
         }
-        if (!found)
+
+        out.push_back(static_cast<char>(kTableDense));
+        for (int s = 0; s < 256; s += 2)
         {
-            frequency.push_back(make_pair(c, 1));
+            out.push_back(static_cast<char>((lengths[s] << 4) | lengths[s + 1]));
         }
     }
-    // Sort frequency vector ascending by frequency (example analysis step)
-    sort(frequency.begin(), frequency.end(), [](const pair<char, int> &a, const pair<char, int> &b)
-         { return a.second < b.second; });
 
-    // Create a node for each character (example analysis step)
-    vector<NodeLetter *> nodes;
-    for (const auto &pair : frequency)
+    // Parse a code-length table at base[pos..end)
+    bool readCodeLengths(const char *base, size_t &pos, size_t end, uint8_t lengths[256])
     {
-        nodes.push_back(new NodeLetter(pair.second, pair.first));
+        memset(lengths, 0, 256);
+        if (pos >= end)
+        {
+            return false;
+        }
+        uint8_t tableKind = static_cast<uint8_t>(base[pos++]);
+        if (tableKind == kTableSparse)
+        {
+            if (pos >= end)
+            {
+                return false;
+            }
+            size_t count = static_cast<unsigned char>(base[pos++]) + size_t(1);
+            if (end - pos < 2 * count)
+            {
+                return false;
+            }
+            for (size_t i = 0; i < count; ++i)
+            {
+                unsigned char sym = static_cast<unsigned char>(base[pos++]);
+                lengths[sym] = static_cast<uint8_t>(base[pos++]);
+            }
+        }
+        else if (tableKind == kTableDense)
+        {
+            if (end - pos < kDenseTableBytes)
+            {
+                return false;
+            }
+            for (int s = 0; s < 256; s += 2)
+            {
+                unsigned char b = static_cast<unsigned char>(base[pos++]);
+                lengths[s] = b >> 4;
+                lengths[s + 1] = b & 0x0F;
+            }
+        }
+        else if (tableKind != kTableEmpty)
+        {
+            return false;
+        }
+        return true;
     }
 
-    do
-    {
-        // sort nodes by frequency
-        sort(nodes.begin(), nodes.end(), [](NodeLetter *a, NodeLetter *b)
-             { return a->id < b->id; });
-        NodeLetter *newNode = new NodeLetter(
-            nodes[0]->id + nodes[1]->id, // sum frequencies
-            '\0'                         // no character
-        );
+    // ---- encoding side ----
 
-        newNode->izq = nodes[0];
-        newNode->der = nodes[1];
-        nodes.erase(nodes.begin(), nodes.begin() + 2);
-        nodes.push_back(newNode);
-        // print nodes  for debug
-        /*
-        for (const auto &node : nodes)
+    // Everything needed to place and encode one block
+    struct EncodedBlock
+    {
+        const unsigned char *data;
+        size_t size;
+        unsigned streams;
+        bool stored;         // raw bytes, no code
+        vector<char> table;  // serialized code lengths
+        vector<char> layout; // stream count, paddings, stream sizes
+        HuffmanEncodeTable encoder;
+        size_t streamBytes[HuffmanDecodeTable::kMaxStreams];
+        size_t payloadBytes;
+        size_t headerBytes; // varint rawSize + bodySize
+        size_t offset;      // of the frame header in the output
+
+        size_t bodyBytes() const { return table.size() + layout.size() + payloadBytes; }
+        size_t frameBytes() const { return headerBytes + bodyBytes(); }
+        size_t payloadOffset() const { return offset + headerBytes + table.size() + layout.size(); }
+    };
+
+    // Per-stream payload sizes and stream layout of a block for b.encoder
+    void planLayout(EncodedBlock &b, const uint64_t streamFreq[][256])
+    {
+        b.layout.assign(1, static_cast<char>(b.streams));
+        b.payloadBytes = 0;
+        for (unsigned i = 0; i < b.streams; ++i)
+        {
+            uint64_t bits = b.encoder.encodedBits(streamFreq[i]);
+            b.streamBytes[i] = static_cast<size_t>((bits + 7) / 8);
+            b.payloadBytes += b.streamBytes[i];
+            b.layout.push_back(static_cast<char>(b.streamBytes[i] * 8 - bits));
+        }
+        for (unsigned i = 0; i + 1 < b.streams; ++i)
         {
-            cout << nodes.size() << " - \n";
-            cout << "Node ID: " << node->id << ", Char: " << node->letra << endl;
-            // print children
-            if (node->izq)
-                cout << "  Left Child ID: " << node->izq->id << ", Char: " << node->izq->letra << endl;
-            if (node->der)
-                cout << "  Right Child ID: " << node->der->id << ", Char: " << node->der->letra << endl;
+            char buf[Varint::kMaxBytes];
+            b.layout.insert(b.layout.end(), buf, Varint::store(buf, b.streamBytes[i]));
         }
-        */
-    } 
-    //build the Huffman tree by merging the two nodes with the lowest frequency
-    while (nodes.size() > 1);
-    // root of the built Huffman tree
-    NodeLetter *root = nodes.empty() ? nullptr : nodes[0];
-    map<char, string> huffmanCodes;
-    generateCodes(root, "", huffmanCodes);
-    
-    //compress the input
-    string bitString;
-    for (char c : input)
+    }
+
+    // Code table of the block's own histogram
+    void planCode(EncodedBlock &b, const uint64_t freq[256],
+                  const uint64_t streamFreq[][256], unsigned maxCodeLength)
+    {
+        StageTimer timer(Stats::Stage::Tree, b.size);
+        uint8_t lengths[256];
+        uint32_t codes[256];
+        HuffmanCanonical::buildCodeLengths(freq, maxCodeLength, lengths);
+        HuffmanCanonical::assignCodes(lengths, codes);
+        b.table.clear();
+        writeCodeLengths(b.table, lengths);
+        b.encoder.build(codes, lengths);
+        planLayout(b, streamFreq);
+    }
+
+    // Dictionary code: no tree, only a reference to its ID
+    void planDict(EncodedBlock &b, const uint64_t streamFreq[][256], const HuffmanDictionary &dict)
     {
-        bitString += huffmanCodes[c];
+        b.table.assign(kDictRefBytes, static_cast<char>(kTableDict));
+        storeU32(b.table.data() + 1, dict.id());
+        b.encoder = dict.encodeTable();
+        planLayout(b, streamFreq);
     }
-    vector<char> compressedInput;
-    unsigned char currentByte = 0;
-    int bitCount = 0;
-    for (char bit : bitString)
+
+    // Histogram and code table for a block, or the decision to store it
+    // raw. The per-stream histograms give the exact payload sizes, so the
+    // block's frame can be laid out before encoding.
+    void planBlock(EncodedBlock &b, unsigned maxCodeLength, unsigned histogramThreads,
+                   const HuffmanDictionary *dict)
     {
-        currentByte = (currentByte << 1) | (bit - '0');
-        bitCount++;
-        if (bitCount == 8)
+        uint64_t freq[256] = {};
+        uint64_t streamFreq[HuffmanDecodeTable::kMaxStreams][256];
+        size_t seg = streamSegment(b.size, b.streams);
         {
-            compressedInput.push_back(currentByte);
-            currentByte = 0;
-            bitCount = 0;
+            StageTimer timer(Stats::Stage::Histogram, b.size);
+            for (unsigned i = 0; i < b.streams; ++i)
+            {
+                size_t begin = min(b.size, i * seg);
+                Histogram::count(b.data + begin, min(b.size, begin + seg) - begin, streamFreq[i], histogramThreads);
+                for (int s = 0; s < 256; ++s)
+                    freq[s] += streamFreq[i][s];
+            }
         }
+
+        // Already-compressed data: no prefix code can beat the entropy, so
+        // skip the code and the encoder when that bound is close to 8 bits
+        // per byte
+        double rawBits = 8.0 * b.size;
+        double entropy = b.size > 0 ? Histogram::entropyBits(freq) : 0;
+        b.stored = b.size > 0 && entropy >= rawBits - rawBits / (1u << kStoredGainShift);
+        if (!b.stored && dict && dict->covers(freq))
+        {
+            planDict(b, streamFreq, *dict);
+            // a code of its own can be no better than the entropy plus its
+            // table; only try one when the dictionary misses by more
+            if (8.0 * b.payloadBytes > entropy + 8.0 * (kDenseTableBytes + 1))
+            {
+                size_t dictBytes = b.bodyBytes();
+                planCode(b, freq, streamFreq, maxCodeLength);
+                if (b.bodyBytes() >= dictBytes)
+                    planDict(b, streamFreq, *dict);
+            }
+        }
+        else if (!b.stored)
+        {
+            planCode(b, freq, streamFreq, maxCodeLength);
+        }
+        if (!b.stored)
+        {
+            // the exact size still decides: table and padding cost bytes too
+            b.stored = b.bodyBytes() > 1 + b.size;
+        }
+        if (b.stored)
+        {
+            b.table.assign(1, static_cast<char>(kTableStored));
+            b.layout.clear();
+            b.payloadBytes = b.size;
+        }
+        b.headerBytes = Varint::size(b.size) + Varint::size(b.bodyBytes());
     }
-    //calculate padding with bits that are left
-    uint8_t padding = (bitCount == 0) ? 0 : (uint8_t)(8 - bitCount);
 
-    //if there are left bits, run to the left and write the last byte
-    if (bitCount > 0){
-        currentByte <<= (8 - bitCount);
-        compressedInput.push_back(currentByte);
+    // Encode the sub-streams of a planned block back to back. Each one may
+    // spill a word store into the next, which then overwrites it.
+    void encodeBlock(const EncodedBlock &b, unsigned char *payload)
+    {
+        if (b.stored)
+        {
+            memcpy(payload, b.data, b.size);
+            return;
+        }
+        StageTimer timer(Stats::Stage::Encode, b.size);
+        size_t seg = streamSegment(b.size, b.streams);
+        for (unsigned i = 0; i < b.streams; ++i)
+        {
+            size_t begin = min(b.size, i * seg);
+            b.encoder.encode(b.data + begin, min(b.size, begin + seg) - begin, payload);
+            payload += b.streamBytes[i];
+        }
     }
 
-    /*
-    //print codes 
-    for (const auto &code : huffmanCodes)
+    // Frame header, code table and stream layout of a planned block
+    void writeFrameHeader(const EncodedBlock &b, char *frame)
     {
-        cout << code.first << " -> " << code.second << endl;
+        frame = Varint::store(frame, b.size);
+        frame = Varint::store(frame, b.bodyBytes());
+        memcpy(frame, b.table.data(), b.table.size());
+        memcpy(frame + b.table.size(), b.layout.data(), b.layout.size());
     }
-    */
-    // Convert string to vector<char> for return
 
+    // Code table, stream layout and payload of a planned block, appended to
+    // body; the payload's trailing word store spills into slack cut off after
+    void appendBody(const EncodedBlock &b, vector<char> &body)
+    {
+        size_t at = body.size();
+        body.resize(at + b.bodyBytes() + HuffmanEncodeTable::kOutputSlack);
+        char *p = body.data() + at;
+        memcpy(p, b.table.data(), b.table.size());
+        memcpy(p + b.table.size(), b.layout.data(), b.layout.size());
+        encodeBlock(b, reinterpret_cast<unsigned char *>(p + b.table.size() + b.layout.size()));
+        body.resize(at + b.bodyBytes());
+    }
 
-    
+    // ---- decoding side ----
 
+    // A block located in a container, with its code lengths already parsed
+    struct BlockRef
+    {
+        size_t outOffset;
+        size_t rawSize;
+        size_t payloadPos;
+        size_t payloadBytes;
+        bool stored;
+        bool dict;       // coded with the dictionary dictId
+        uint32_t dictId;
+        unsigned streams;
+        uint8_t pads[HuffmanDecodeTable::kMaxStreams];
+        size_t streamBytes[HuffmanDecodeTable::kMaxStreams];
+        uint8_t lengths[256];
+    };
+
+    // Every symbol costs at least one bit
+    bool checkStreams(const BlockRef &b)
+    {
+        size_t seg = streamSegment(b.rawSize, b.streams);
+        for (unsigned i = 0; i < b.streams; ++i)
+        {
+            size_t begin = min(b.rawSize, i * seg);
+            if (b.pads[i] > 7 || (min(b.rawSize, begin + seg) - begin) / 8 > b.streamBytes[i])
+                return false;
+        }
+        return true;
+    }
 
-    //Save frecuency tree for decompression
-    ofstream freqFile("freqTable.bin", ios::binary);
+    // Parse a framed block body at base[pos..end)
+    bool parseBlockBody(const char *base, size_t pos, size_t end, uint8_t version,
+                        uint64_t rawSize, BlockRef &b)
+    {
+        b.rawSize = static_cast<size_t>(rawSize);
+        b.stored = version >= kFormatVersion && pos < end &&
+                   static_cast<uint8_t>(base[pos]) == kTableStored;
+        if (b.stored)
+        {
+            b.payloadPos = pos + 1;
+            b.payloadBytes = end - b.payloadPos;
+            return b.payloadBytes == rawSize;
+        }
+        b.dict = version >= kFormatVersion && pos < end &&
+                 static_cast<uint8_t>(base[pos]) == kTableDict;
+        if (b.dict)
+        {
+            if (end - pos < kDictRefBytes)
+                return false;
+            b.dictId = loadU32(base + pos + 1);
+            pos += kDictRefBytes;
+        }
+        else if (!readCodeLengths(base, pos, end, b.lengths))
+        {
+            return false;
+        }
+        if (pos >= end)
+        {
+            return false;
+        }
+        b.streams = version >= kFormatVersion ? static_cast<uint8_t>(base[pos++]) : 1;
+        if (b.streams == 0 || b.streams > HuffmanDecodeTable::kMaxStreams || end - pos < b.streams)
+        {
+            return false;
+        }
+        for (unsigned i = 0; i < b.streams; ++i)
+        {
+            b.pads[i] = static_cast<uint8_t>(base[pos++]);
+        }
+        size_t sized = 0;
+        for (unsigned i = 0; i + 1 < b.streams; ++i)
+        {
+            uint64_t n;
+            if (Varint::load(base, pos, end, n) != Varint::kOk || n > end - pos)
+            {
+                return false;
+            }
+            b.streamBytes[i] = static_cast<size_t>(n);
+            sized += b.streamBytes[i];
+        }
+        b.payloadPos = pos;
+        b.payloadBytes = end - pos;
+        if (sized > b.payloadBytes)
+        {
+            return false;
+        }
+        b.streamBytes[b.streams - 1] = b.payloadBytes - sized;
+        return checkStreams(b);
+    }
 
-    uint16_t symbolCount = static_cast<uint16_t>(frequency.size());
-    freqFile.write(reinterpret_cast<const char*>(&symbolCount), sizeof(symbolCount));
+    bool decodeBlock(const BlockRef &b, const char *base, char *out, const HuffmanDictionary *dict)
+    {
+        if (b.stored)
+        {
+            memcpy(out, base + b.payloadPos, b.rawSize);
+            return true;
+        }
+        uint32_t codes[256];
+        HuffmanDecodeTable own;
+        const HuffmanDecodeTable *table = &own;
+        if (b.dict)
+        {
+            if (!dict || dict->id() != b.dictId)
+                return false;
+            table = &dict->decodeTable();
+        }
+        else
+        {
+            StageTimer timer(Stats::Stage::DecodeTable, b.rawSize);
+            if (!HuffmanCanonical::assignCodes(b.lengths, codes) || !own.build(codes, b.lengths))
+                return false;
+        }
 
-    for (auto& p : frequency) {
-        char sym = p.first;
-        int32_t freq = p.second;
-        freqFile.write(reinterpret_cast<const char*>(&sym),  sizeof(sym));
-        freqFile.write(reinterpret_cast<const char*>(&freq), sizeof(freq));
+        const unsigned char *payload[HuffmanDecodeTable::kMaxStreams];
+        size_t totalBits[HuffmanDecodeTable::kMaxStreams];
+        char *outs[HuffmanDecodeTable::kMaxStreams];
+        size_t outSize[HuffmanDecodeTable::kMaxStreams];
+        const unsigned char *p = reinterpret_cast<const unsigned char *>(base) + b.payloadPos;
+        size_t seg = streamSegment(b.rawSize, b.streams);
+        for (unsigned i = 0; i < b.streams; ++i)
+        {
+            size_t begin = min(b.rawSize, i * seg);
+            payload[i] = p;
+            p += b.streamBytes[i];
+            totalBits[i] = b.streamBytes[i] * 8;
+            if (b.pads[i] > 0 && totalBits[i] >= b.pads[i])
+            {
+                totalBits[i] -= b.pads[i];
+            }
+            outs[i] = out + begin;
+            outSize[i] = min(b.rawSize, begin + seg) - begin;
+        }
+        StageTimer timer(Stats::Stage::Decode, b.rawSize);
+        return table->decodeStreams(b.streams, payload, b.streamBytes, totalBits, outs, outSize);
     }
 
-    // add padding and original size for decompression
-    uint8_t  pad = padding;
-    uint32_t originalSize = static_cast<uint32_t>(input.size());
-    freqFile.write(reinterpret_cast<const char*>(&pad),          sizeof(pad));
-    freqFile.write(reinterpret_cast<const char*>(&originalSize), sizeof(originalSize));
-
-    freqFile.close();
+    // HuffmanCompression with a done hook: one block at a time is planned,
+    // encoded into place and handed to done while it is still in cache.
+    // The output is reserved for the worst case (stored frames) up front,
+    // so it never moves, and each frame's bytes are touched only by it.
+    vector<char> compressFrames(const vector<char> &input, unsigned maxCodeLength, size_t blockSize,
+                                unsigned threads, unsigned streams, const HuffmanDictionary *dict,
+                                const RangeFn &done)
+    {
+        size_t blockCount = (input.size() + blockSize - 1) / blockSize;
+        vector<char> out;
+        out.reserve(kContainerHeaderBytes + input.size() + blockCount * (1 + 2 * Varint::kMaxBytes) +
+                    sizeof(kTerminator) + HuffmanEncodeTable::kOutputSlack);
+        out.insert(out.end(), kMagic, kMagic + sizeof(kMagic));
+        out.push_back(static_cast<char>(kFormatVersion));
+        done(out.data(), out.size(), 0);
+
+        EncodedBlock b;
+        b.streams = max(1u, min(streams, HuffmanDecodeTable::kMaxStreams));
+        for (size_t i = 0; i < blockCount; ++i)
+        {
+            b.data = reinterpret_cast<const unsigned char *>(input.data()) + i * blockSize;
+            b.size = min(blockSize, input.size() - i * blockSize);
+            b.offset = out.size();
+            planBlock(b, maxCodeLength, blockCount == 1 ? threads : 1, dict);
+            // the payload's trailing word store spills into slack that the
+            // next frame overwrites
+            out.resize(b.offset + b.frameBytes() + HuffmanEncodeTable::kOutputSlack);
+            encodeBlock(b, reinterpret_cast<unsigned char *>(out.data()) + b.payloadOffset());
+            writeFrameHeader(b, out.data() + b.offset);
+            out.resize(b.offset + b.frameBytes());
+            done(out.data() + b.offset, b.frameBytes(), b.offset);
+        }
+        size_t at = out.size();
+        out.insert(out.end(), kTerminator, kTerminator + sizeof(kTerminator));
+        done(out.data() + at, sizeof(kTerminator), at);
+        return out;
+    }
 
-    //delete memory from the tree recursively
-    deleteTree(root);
+    // Validate a container and locate all of its blocks
+    bool scanContainer(const vector<char> &container, vector<BlockRef> &blocks, size_t &originalSize)
+    {
+        blocks.clear();
+        originalSize = 0;
+        const char *base = container.data();
+        const size_t size = container.size();
+        if (size < kContainerHeaderBytes || memcmp(base, kMagic, sizeof(kMagic)) != 0)
+        {
+            return false;
+        }
+        size_t pos = sizeof(kMagic);
+        uint8_t version = static_cast<uint8_t>(base[pos++]);
 
-    return compressedInput;
-    
-}
+        if (version == kVersionSingle)
+        {
+            // lengths, padding, uint32 original size, payload to the end
+            BlockRef b;
+            if (!readCodeLengths(base, pos, size, b.lengths) || size - pos < 5)
+            {
+                return false;
+            }
+            b.pads[0] = static_cast<uint8_t>(base[pos++]);
+            b.outOffset = 0;
+            b.rawSize = loadU32(base + pos);
+            pos += 4;
+            b.payloadPos = pos;
+            b.payloadBytes = size - pos;
+            b.stored = false;
+            b.dict = false;
+            b.streams = 1;
+            b.streamBytes[0] = b.payloadBytes;
+            // the uint32 size is bounded by the payload before anything is
+            // allocated for it, as for the framed versions
+            if (!checkStreams(b))
+            {
+                return false;
+            }
+            if (b.rawSize > 0)
+                blocks.push_back(b);
+            originalSize = b.rawSize;
+            return true;
+        }
 
-void Huffman::generateCodes(NodeLetter *node, string code, map<char, string> &huffmanCodes)
-{
-    if (!node) return;
+        if (!isFramedVersion(version))
+        {
+            return false;
+        }
 
-    if (node->izq == nullptr && node->der == nullptr)
-    {
-        huffmanCodes[node->letra] = code.empty() ? "0" : code; // if the code is empty, set it to "0"
-        return;
+        for (;;)
+        {
+            uint64_t rawSize, bodySize;
+            if (readFrameHeader(base, pos, size, version, rawSize, bodySize) != Varint::kOk)
+            {
+                return false;
+            }
+            if (rawSize == 0)
+            {
+                // terminator frame; nothing may follow it
+                return bodySize == 0 && pos == size;
+            }
+            if (size - pos < bodySize)
+            {
+                return false;
+            }
+            BlockRef b;
+            if (!parseBlockBody(base, pos, pos + bodySize, version, rawSize, b))
+            {
+                return false;
+            }
+            b.outOffset = originalSize;
+            blocks.push_back(b);
+            originalSize += rawSize;
+            pos += bodySize;
+        }
     }
-    generateCodes(node->izq, code + "0", huffmanCodes);
-    generateCodes(node->der, code + "1", huffmanCodes);
 }
 
+// ====== Dictionary ======
 
-bool Huffman::loadFreqAndBuildTree(const string &path,
-                                   vector<pair<char, int>> &freq,
-                                   uint8_t &pad,
-                                   uint32_t &originalSize,
-                                   NodeLetter *&root)
+bool HuffmanDictionary::train(const uint64_t freq[256], HuffmanDictionary &dict, unsigned maxCodeLength)
 {
-    ifstream f(path, ios::binary);
-    if (!f)
+    uint8_t lengths[256];
+    HuffmanCanonical::buildCodeLengths(freq, maxCodeLength, lengths);
+    HuffmanDictionary trained;
+    if (!trained.init(lengths))
     {
         return false;
     }
+    dict = trained;
+    return true;
+}
 
-    uint16_t symbolCount = 0;
-    f.read(reinterpret_cast<char *>(&symbolCount), sizeof(symbolCount));
-    if (!f)
+bool HuffmanDictionary::init(const uint8_t lengths[256])
+{
+    uint32_t codes[256];
+    if (!HuffmanCanonical::assignCodes(lengths, codes) || !decoder_.build(codes, lengths) ||
+        *max_element(lengths, lengths + 256) == 0)
     {
         return false;
     }
+    encoder_.build(codes, lengths);
+    memcpy(lengths_, lengths, sizeof(lengths_));
 
-    freq.clear();
-    freq.reserve(symbolCount);
-    for (uint16_t i = 0; i < symbolCount; ++i)
+    // FNV-1a of the lengths: the code is fully determined by them
+    id_ = 2166136261u;
+    for (int s = 0; s < 256; ++s)
+        id_ = (id_ ^ lengths[s]) * 16777619u;
+    return true;
+}
+
+bool HuffmanDictionary::covers(const uint64_t freq[256]) const
+{
+    for (int s = 0; s < 256; ++s)
     {
-        char sym;
-        int32_t fr;
-        f.read(reinterpret_cast<char *>(&sym), sizeof(sym));
-        f.read(reinterpret_cast<char *>(&fr), sizeof(fr));
-        if (!f)
-        {
+        if (freq[s] > 0 && lengths_[s] == 0)
             return false;
-        }
-        freq.push_back({sym, static_cast<int>(fr)});
     }
+    return true;
+}
+
+vector<char> HuffmanDictionary::serialize() const
+{
+    vector<char> out(kDictMagic, kDictMagic + sizeof(kDictMagic));
+    out.push_back(static_cast<char>(kDictVersion));
+    out.resize(out.size() + 4);
+    storeU32(out.data() + out.size() - 4, id_);
+    writeCodeLengths(out, lengths_);
+    return out;
+}
 
-    f.read(reinterpret_cast<char *>(&pad), sizeof(pad));
-    f.read(reinterpret_cast<char *>(&originalSize), sizeof(originalSize));
-    if (!f)
+bool HuffmanDictionary::parse(const vector<char> &data, HuffmanDictionary &dict)
+{
+    const char *base = data.data();
+    const size_t headerBytes = sizeof(kDictMagic) + 1 + 4;
+    if (data.size() < headerBytes || memcmp(base, kDictMagic, sizeof(kDictMagic)) != 0 ||
+        static_cast<uint8_t>(base[sizeof(kDictMagic)]) != kDictVersion)
     {
         return false;
     }
-
-    // Build Huffman tree using the same strategy as compression (sort by frequency ascending)
-    vector<NodeLetter *> nodes;
-    nodes.reserve(freq.size());
-    for (auto &p : freq)
+    uint32_t id = loadU32(base + sizeof(kDictMagic) + 1);
+    size_t pos = headerBytes;
+    uint8_t lengths[256];
+    HuffmanDictionary parsed;
+    if (!readCodeLengths(base, pos, data.size(), lengths) || pos != data.size() ||
+        !parsed.init(lengths) || parsed.id() != id)
     {
-        nodes.push_back(new NodeLetter(p.second, p.first));
+        return false;
     }
+    dict = parsed;
+    return true;
+}
 
-    if (nodes.empty())
+// ====== Container ======
+
+std::vector<char> Huffman::HuffmanCompression(const std::vector<char> &input, unsigned maxCodeLength,
+                                              size_t blockSize, unsigned threads, unsigned streams,
+                                              const HuffmanDictionary *dict, const RangeFn &done)
+{
+    // Split the input into independent blocks, each with its own
+    // length-limited canonical code, and emit a self-contained container.
+    // No files are touched.
+    const unsigned char *data = reinterpret_cast<const unsigned char *>(input.data());
+    if (blockSize == 0)
+        blockSize = max<size_t>(input.size(), 1);
+    if (done)
+        return compressFrames(input, maxCodeLength, blockSize, threads, streams, dict, done);
+    size_t blockCount = (input.size() + blockSize - 1) / blockSize;
+
+    vector<EncodedBlock> blocks(blockCount);
+    for (size_t i = 0; i < blockCount; ++i)
     {
-        root = nullptr;
-        return true;
+        blocks[i].data = data + i * blockSize;
+        blocks[i].size = min(blockSize, input.size() - i * blockSize);
+        blocks[i].streams = max(1u, min(streams, HuffmanDecodeTable::kMaxStreams));
     }
 
-    while (nodes.size() > 1)
+    // Pass 1: histogram and code table per block
+    parallelFor(blockCount, threads, [&](size_t i)
+                { planBlock(blocks[i], maxCodeLength, blockCount == 1 ? threads : 1, dict); });
+
+    //lay out the container: header, framed blocks, terminator frame
+    size_t total = kContainerHeaderBytes;
+    for (auto &b : blocks)
     {
-        sort(nodes.begin(), nodes.end(), [](NodeLetter *a, NodeLetter *b)
-                  { return a->id < b->id; });
-        NodeLetter *left = nodes[0];
-        NodeLetter *right = nodes[1];
-        NodeLetter *parent = new NodeLetter(left->id + right->id, '\0');
-        parent->izq = left;
-        parent->der = right;
-        nodes.erase(nodes.begin(), nodes.begin() + 2);
-        nodes.push_back(parent);
+        b.offset = total;
+        total += b.frameBytes();
     }
+    total += sizeof(kTerminator);
+
+    vector<char> compressedInput(total + HuffmanEncodeTable::kOutputSlack);
+    char *out = compressedInput.data();
+
+    // Pass 2: encode every payload straight into place. A block's trailing
+    // word store may spill up to 7 bytes past its payload, into the next
+    // frame's header and code table (never fewer than 7 bytes) or into the
+    // first bytes of a stored block, so those are written only after all
+    // payloads are done.
+    auto payloadAt = [&](const EncodedBlock &b)
+    { return reinterpret_cast<unsigned char *>(out) + b.payloadOffset(); };
+    parallelFor(blockCount, threads, [&](size_t i)
+                {
+        if (!blocks[i].stored)
+            encodeBlock(blocks[i], payloadAt(blocks[i])); });
+
+    // Pass 3: frame headers and stored blocks
+    memcpy(out, kMagic, sizeof(kMagic));
+    out[sizeof(kMagic)] = static_cast<char>(kFormatVersion);
+    parallelFor(blockCount, threads, [&](size_t i)
+                {
+        writeFrameHeader(blocks[i], out + blocks[i].offset);
+        if (blocks[i].stored)
+            encodeBlock(blocks[i], payloadAt(blocks[i])); });
+    memcpy(out + total - sizeof(kTerminator), kTerminator, sizeof(kTerminator));
+
+    compressedInput.resize(total);
+    return compressedInput;
+}
 
-    root = nodes[0];
-    return true;
+size_t Huffman::containerOverheadSize(const vector<char> &compressed)
+{
+    vector<BlockRef> blocks;
+    size_t originalSize = 0;
+
+    if (!scanContainer(compressed, blocks, originalSize))
+    {
+        return 0;
+    }
+    size_t payload = 0;
+    for (const auto &b : blocks)
+    {
+        payload += b.payloadBytes;
+    }
+    return compressed.size() - payload;
 }
 
-// Decompression function that uses the frequency table to decompress the compressed file
-vector<char> Huffman::HuffmanDecompression(const vector<char> &compressed)
+// Decompression function that rebuilds the canonical codes of every block
+// from the stored code lengths and decodes the blocks through lookup tables
+vector<char> Huffman::HuffmanDecompression(const vector<char> &compressed, unsigned threads,
+                                           const HuffmanDictionary *dict)
 {
-    vector<pair<char, int>> freq;
-    uint8_t pad = 0;
-    uint32_t originalSize = 0;
-    NodeLetter *root = nullptr;
+    vector<BlockRef> blocks;
+    size_t originalSize = 0;
 
-    if (!loadFreqAndBuildTree("freqTable.bin", freq, pad, originalSize, root))
+    if (!scanContainer(compressed, blocks, originalSize))
     {
         return {};
     }
 
-    vector<char> output;
-    output.reserve(originalSize);
+    vector<char> output(originalSize);
+    atomic<bool> ok{true};
+    parallelFor(blocks.size(), threads, [&](size_t i)
+                {
+        if (!decodeBlock(blocks[i], compressed.data(), output.data() + blocks[i].outOffset, dict))
+            ok = false; });
 
-    if (!root)
+    if (!ok)
     {
-        return output;
+        return {};
     }
+    return output;
+}
 
-    size_t totalBits = compressed.size() * 8;
-    if (pad > 0 && totalBits >= pad)
+bool Huffman::HuffmanDecompression(vector<char> &compressed, const RangeFn &reveal, vector<char> &output,
+                                   const HuffmanDictionary *dict)
+{
+    output.clear();
+    char *base = compressed.data();
+    const size_t size = compressed.size();
+    char header[2 * Varint::kMaxBytes];
+    if (size < kContainerHeaderBytes)
+        return false;
+    memcpy(header, base, kContainerHeaderBytes);
+    reveal(header, kContainerHeaderBytes, 0);
+    uint8_t version = static_cast<uint8_t>(header[sizeof(kMagic)]);
+    if (memcmp(header, kMagic, sizeof(kMagic)) != 0)
+        return false;
+    if (!isFramedVersion(version))
     {
-        totalBits -= pad;
+        // version 2 has no frames to reveal one by one
+        reveal(base, size, 0);
+        output = HuffmanDecompression(compressed, 1, dict);
+        return !output.empty() || containerOverheadSize(compressed) == size;
     }
 
-    NodeLetter *node = root;
-    size_t bitIndex = 0;
-    for (size_t i = 0; i < compressed.size() && output.size() < originalSize; ++i)
+    // Pass 1: frame headers, revealed in a copy. The expansion bound makes
+    // the total safe to allocate before any body is parsed.
+    struct Frame
+    {
+        size_t bodyPos, bodySize, rawSize;
+    };
+    vector<Frame> frames;
+    size_t total = 0;
+    size_t pos = kContainerHeaderBytes;
+    for (;;)
     {
-        unsigned char byte = static_cast<unsigned char>(compressed[i]);
-        for (int b = 7; b >= 0 && bitIndex < totalBits && output.size() < originalSize; --b, ++bitIndex)
+        size_t n = min(sizeof(header), size - pos), p = 0;
+        memcpy(header, base + pos, n);
+        reveal(header, n, pos);
+        uint64_t rawSize, bodySize;
+        if (readFrameHeader(header, p, n, version, rawSize, bodySize) != Varint::kOk)
+            return false;
+        pos += p;
+        if (rawSize == 0)
         {
-            int bit = (byte >> b) & 1;
-            node = bit == 0 ? node->izq : node->der;
-            if (node->izq == nullptr && node->der == nullptr)
-            {
-                output.push_back(node->letra);
-                node = root;
-            }
+            if (bodySize != 0 || pos != size)
+                return false;
+            break;
+        }
+        if (size - pos < bodySize || (rawSize - 1) / kMaxExpansion >= bodySize)
+            return false;
+        frames.push_back({pos, static_cast<size_t>(bodySize), static_cast<size_t>(rawSize)});
+        total += frames.back().rawSize;
+        pos += bodySize;
+    }
+
+    // Pass 2: each body revealed in place and decoded while in cache
+    output.resize(total);
+    char *out = output.data();
+    for (const Frame &f : frames)
+    {
+        reveal(base + f.bodyPos, f.bodySize, f.bodyPos);
+        BlockRef b;
+        if (!parseBlockBody(base, f.bodyPos, f.bodyPos + f.bodySize, version, f.rawSize, b) ||
+            !decodeBlock(b, base, out, dict))
+        {
+            return false;
         }
+        out += f.rawSize;
     }
+    return true;
+}
 
-    deleteTree(root);
-    return output;
+// ====== Streaming encoder ======
+
+HuffmanEncoder::HuffmanEncoder(ByteSink sink, unsigned maxCodeLength, size_t blockSize, unsigned streams,
+                               const HuffmanDictionary *dict)
+    : frames_(std::move(sink), kMagic, kFormatVersion, blockSize,
+              [maxCodeLength, streams = max(1u, min(streams, HuffmanDecodeTable::kMaxStreams)), dict](
+                  const char *data, size_t size, vector<char> &body)
+              {
+                  EncodedBlock b;
+                  b.data = reinterpret_cast<const unsigned char *>(data);
+                  b.size = size;
+                  b.streams = streams;
+                  b.offset = 0;
+                  planBlock(b, maxCodeLength, 1, dict);
+                  appendBody(b, body);
+              },
+              kMaxExpansion)
+{
+}
+
+// ====== Streaming decoder ======
+
+HuffmanDecoder::HuffmanDecoder(ByteSink sink, const HuffmanDictionary *dict)
+    : frames_(std::move(sink), kMagic, kFormatVersion,
+              [this, dict](const char *body, size_t bodySize, char *out, size_t rawSize)
+              {
+                  BlockRef b;
+                  return parseBlockBody(body, 0, bodySize, frames_.version(), rawSize, b) &&
+                         decodeBlock(b, body, out, dict);
+              },
+              kMaxExpansion, kVersionFrames32, readFrameHeader)
+{
 }
 
 //function to read the uncompressed file
@@ -1,12 +1,66 @@
-
 /*
  * Huffman.h
  *
- * Minimal header declaring the Huffman class used for compression.
- * It exposes a single public method:
- *   void HuffmanCompression(const std::string &filePath);
+ * Header declaring the Huffman class used for compression.
+ *
+ * HuffmanCompression produces a self-contained .huf container: a small
+ * versioned header followed by the encoded payload. Nothing is written to
+ * disk, so any number of threads may compress/decompress concurrently.
+ *
+ * The input is split into independent blocks (optionally of a fixed size),
+ * each with its own canonical, length-limited code, so blocks can be
+ * encoded and decoded on separate threads. Only code lengths are stored.
+ *
+ * Container layout (version 5):
+ *   magic        4 bytes  "HUFV"
+ *   version      uint8
+ *   blocks       repeated frame:
+ *     rawSize    varint   uncompressed bytes in the block (0 = terminator)
+ *     bodySize   varint   bytes of the block body that follows
+ *     body:
+ *       tableKind uint8   0 = empty, 1 = sparse, 2 = dense, 3 = stored, 4 = dictionary
+ *       lengths   sparse: uint8 count-1, then count x (uint8 symbol, uint8 length)
+ *                 dense:  128 bytes, two 4-bit lengths per byte (symbol 0 high nibble)
+ *                 dictionary: uint32 little-endian dictionary ID, no lengths
+ *       streams   uint8   number of sub-streams, 1..8
+ *       padding   streams x uint8, unused bits in the last byte of each sub-stream
+ *       sizes     (streams - 1) x varint, payload bytes of every sub-stream but the last
+ *       payload   the sub-streams back to back, packed code bits, MSB first
+ *     stored body (tableKind 3): the rawSize bytes of the block, uncoded
+ *   terminator   frame with rawSize = 0 and bodySize = 0
+ *
+ * Varints are LEB128 (7 bits per byte, low group first), so sizes and
+ * blocks may exceed 4 GiB. Sub-stream i encodes the i-th of `streams`
+ * equal slices of the block (ceil(rawSize / streams) bytes, the last one
+ * shorter), huff0-style: one thread decodes all of them in a single
+ * interleaved loop, overlapping their serial bit-reader dependencies.
  *
- * The method takes a file path to compress and returns nothing.
+ * Blocks that would not shrink are stored. The compressor first bounds the
+ * gain by the histogram's entropy and skips building a code when less than
+ * 1/128 of the block could be saved (already-compressed data such as the
+ * Flate streams in PDFs); otherwise a coded block that turns out larger
+ * than its stored form is stored instead. The frame headers form the block index: the
+ * decoder hops over them to locate every block before decoding them in
+ * parallel.
+ *
+ * Older containers are still decoded: version 4 (no streams/sizes fields,
+ * one padding byte), version 3 (version 4 frames with little-endian uint32
+ * rawSize/bodySize) and version 2 (one block: lengths,
+ * padding, uint32 original size, payload to the end).
+ *
+ * A HuffmanDictionary is a code trained once on a sample corpus and saved
+ * to a file (magic "HUFD", version, uint32 ID, code-length table). Blocks
+ * coded with it reference its ID instead of carrying a table, and neither
+ * side builds a tree or tables per block, which is what dominates the
+ * cost and size of small files. A block with bytes the dictionary has no
+ * code for, or that it fits poorly (far above the block's own entropy),
+ * still gets its own code if that is smaller.
+ *
+ * HuffmanEncoder/HuffmanDecoder produce and consume the same version 5
+ * container incrementally through FrameEncoder/FrameDecoder: input is fed
+ * in chunks of any size and output is handed to a sink one block at a
+ * time, so memory stays bounded by the block size no matter how large the
+ * file is.
  */
 
 #ifndef HUFFMAN_H
@@ -14,20 +68,80 @@
 
 #include <string>
 #include <vector>
-#include <map>
 #include <cstdint>
+#include <functional>
+#include "HuffmanTable.h"
+#include "Frame.h"
+
+class HuffmanDictionary
+{
+public:
+    // Code for the byte counts of a training corpus. Only bytes seen in the
+    // corpus get a code, so none of the code space is spent on the rest.
+    // Returns false, leaving dict untouched, if freq counts no bytes.
+    static bool train(const uint64_t freq[256], HuffmanDictionary &dict,
+                      unsigned maxCodeLength = HuffmanCanonical::kDefaultMaxCodeLength);
+
+    // Dictionary file contents; parse() returns false if malformed
+    std::vector<char> serialize() const;
+    static bool parse(const std::vector<char> &data, HuffmanDictionary &dict);
+
+    // True if every byte counted in freq has a code
+    bool covers(const uint64_t freq[256]) const;
+
+    // Derived from the code lengths: equal codes have equal IDs
+    uint32_t id() const { return id_; }
+    const HuffmanEncodeTable &encodeTable() const { return encoder_; }
+    const HuffmanDecodeTable &decodeTable() const { return decoder_; }
+
+private:
+    bool init(const uint8_t lengths[256]);
+
+    uint32_t id_ = 0;
+    uint8_t lengths_[256] = {};
+    HuffmanEncodeTable encoder_;
+    HuffmanDecodeTable decoder_;
+};
 
 class Huffman
 {
 public:
-    // Compress the input buffer using Huffman coding and return the compressed bytes.
-    // Input: buffer with file contents.
-    // Output: buffer with compressed data. Current implementation may be a passthrough
-    // until a real compressor is implemented.
-    static std::vector<char> HuffmanCompression(const std::vector<char> &input);
+    // Compress the input buffer using Huffman coding.
+    // Input: buffer with file contents; the longest code length allowed
+    // (clamped to HuffmanCanonical::kMinMaxCodeLength..kMaxMaxCodeLength);
+    // the block size in bytes (0 = whole input as one block) and the number
+    // of threads used to encode blocks (0 = one per core); the number of
+    // interleaved sub-streams per block (1..HuffmanDecodeTable::kMaxStreams);
+    // an optional dictionary, which must outlive the call; an optional hook
+    // that gets the container header, each frame and the terminator in
+    // place as soon as it is final (blocks are then encoded one at a time).
+    // Output: .huf container (framed blocks with code lengths + payload).
+    static std::vector<char> HuffmanCompression(const std::vector<char> &input,
+                                                unsigned maxCodeLength = HuffmanCanonical::kDefaultMaxCodeLength,
+                                                size_t blockSize = 0,
+                                                unsigned threads = 1,
+                                                unsigned streams = 1,
+                                                const HuffmanDictionary *dict = nullptr,
+                                                const RangeFn &done = nullptr);
+
+    // Decompress a container produced by HuffmanCompression, decoding blocks
+    // on up to `threads` threads (0 = one per core). Blocks coded with a
+    // dictionary need the same dictionary (matched by ID).
+    // Returns an empty buffer if the container is malformed.
+    static std::vector<char> HuffmanDecompression(const std::vector<char> &compressed,
+                                                  unsigned threads = 1,
+                                                  const HuffmanDictionary *dict = nullptr);
 
-    // Decompress a buffer produced by HuffmanCompression using freqTable.bin metadata
-    static std::vector<char> HuffmanDecompression(const std::vector<char> &compressed);
+    // Same for a container whose bytes are still transformed (e.g.
+    // encrypted), on one thread: reveal undoes that in place one block body
+    // at a time, right before the block is decoded. Accepts the same
+    // versions; returns false if the container is malformed.
+    static bool HuffmanDecompression(std::vector<char> &compressed, const RangeFn &reveal,
+                                     std::vector<char> &output, const HuffmanDictionary *dict = nullptr);
+
+    // Bytes of the container that are not payload (headers, frames, code
+    // tables), or 0 if the buffer is not a valid container.
+    static size_t containerOverheadSize(const std::vector<char> &compressed);
 
     // Simple helper to read raw buffer from a file
     static std::vector<char> readUncompressedFile(const std::string &path);
@@ -36,19 +150,50 @@ public:
     // Destructor and default constructor are fine as the defaults.
     Huffman() = default;
     ~Huffman() = default;
+};
+
+// Streaming compressor: buffers at most one block of input, encodes it as
+// soon as it is full and passes the framed block to the sink.
+class HuffmanEncoder
+{
+public:
+    // blockSize 0 = FrameEncoder::kDefaultBlockSize; blocks are not limited
+    // to FrameEncoder::kMaxBlockSize. streams and dict as in HuffmanCompression.
+    explicit HuffmanEncoder(ByteSink sink,
+                            unsigned maxCodeLength = HuffmanCanonical::kDefaultMaxCodeLength,
+                            size_t blockSize = FrameEncoder::kDefaultBlockSize,
+                            unsigned streams = 1,
+                            const HuffmanDictionary *dict = nullptr);
+
+    void write(const char *data, size_t size) { frames_.write(data, size); }
+
+    // Encode the last partial block and close the container
+    void finish() { frames_.finish(); }
 
 private:
-    // Helper method to generate Huffman codes
-    static void generateCodes(class NodeLetter *node, std::string code, std::map<char, std::string> &huffmanCodes);
+    FrameEncoder frames_;
+};
+
+// Streaming decompressor for version 3 to 5 containers: every complete block is
+// decoded and passed to the sink; a partial frame waits for more input.
+class HuffmanDecoder
+{
+public:
+    // dict as in HuffmanDecompression
+    explicit HuffmanDecoder(ByteSink sink, const HuffmanDictionary *dict = nullptr);
+
+    // The block decoder reads the container version from frames_
+    HuffmanDecoder(const HuffmanDecoder &) = delete;
+    HuffmanDecoder &operator=(const HuffmanDecoder &) = delete;
 
-    // Helper to read freqTable.bin and rebuild the Huffman tree
-    static bool loadFreqAndBuildTree(const std::string &path,
-                                     std::vector<std::pair<char, int>> &freq,
-                                     uint8_t &pad,
-                                     uint32_t &originalSize,
-                                     class NodeLetter *&root);
+    // Returns false once the input is known to be malformed
+    bool write(const char *data, size_t size) { return frames_.write(data, size); }
 
-    // (no duplicate declarations)
+    // True if the whole container, terminator included, was decoded
+    bool finish() { return frames_.finish(); }
+
+private:
+    FrameDecoder frames_;
 };
 
 #endif // HUFFMAN_H
@@ -0,0 +1,448 @@
+#include "HuffmanTable.h"
+#include "BitIO.h"
+#include "NodeLetter.h"
+#include <algorithm>
+using namespace std;
+
+// min/max take these by reference, so they need a definition
+const unsigned HuffmanCanonical::kMinMaxCodeLength;
+const unsigned HuffmanCanonical::kMaxMaxCodeLength;
+const unsigned HuffmanDecodeTable::kMaxStreams;
+
+void HuffmanCanonical::buildCodeLengths(const uint64_t freq[256], unsigned maxLen, uint8_t lengths[256])
+{
+    maxLen = max(kMinMaxCodeLength, min(maxLen, kMaxMaxCodeLength));
+
+    // one arena per thread, reused by every tree built on it
+    static thread_local NodeLetterTree tree;
+    tree.clear();
+
+    // Node ids give the tie-break order: leaves use their symbol value
+    // (0-255), internal nodes are numbered from 256 as they are created
+    struct Item
+    {
+        uint64_t weight;
+        int id;
+        int node;
+    };
+    auto later = [](const Item &a, const Item &b)
+    {
+        return a.weight != b.weight ? a.weight > b.weight : a.id > b.id;
+    };
+    // at most 256 items are ever waiting, so the heap lives on the stack
+    Item heap[256];
+    size_t count = 0;
+    for (int s = 0; s < 256; ++s)
+    {
+        if (freq[s] > 0)
+        {
+            heap[count++] = Item{freq[s], s, tree.add(s, static_cast<char>(s))};
+            push_heap(heap, heap + count, later);
+        }
+    }
+
+    // merge the two lightest nodes until only the root is left
+    int nextId = 256;
+    while (count > 1)
+    {
+        pop_heap(heap, heap + count--, later);
+        Item a = heap[count];
+        pop_heap(heap, heap + count--, later);
+        Item b = heap[count];
+        heap[count++] = Item{a.weight + b.weight, nextId, tree.join(nextId, a.node, b.node)};
+        nextId++;
+        push_heap(heap, heap + count, later);
+    }
+
+    unsigned depths[256] = {};
+    computeDepths(tree, depths);
+
+    limitCodeLengths(freq, depths, maxLen, lengths);
+}
+
+void HuffmanCanonical::computeDepths(const NodeLetterTree &tree, unsigned depths[256])
+{
+    if (tree.empty())
+        return;
+
+    // parents come after their children, so walking back from the root
+    // sets every node's depth before its children are reached
+    unsigned depth[NodeLetterTree::kMaxNodes];
+    depth[tree.root()] = 0;
+    for (int i = tree.root(); i >= 0; --i)
+    {
+        const NodeLetter &n = tree[i];
+        if (n.isLeaf())
+        {
+            // a lone root still needs one bit per symbol
+            depths[static_cast<unsigned char>(n.letra)] = depth[i] == 0 ? 1 : depth[i];
+            continue;
+        }
+        depth[n.izq] = depth[i] + 1;
+        depth[n.der] = depth[i] + 1;
+    }
+}
+
+void HuffmanCanonical::limitCodeLengths(const uint64_t freq[256], const unsigned depths[256],
+                                        unsigned maxLen, uint8_t lengths[256])
+{
+    int syms[256];
+    size_t n = 0;
+    for (int s = 0; s < 256; ++s)
+    {
+        lengths[s] = 0;
+        if (depths[s] > 0)
+            syms[n++] = s;
+    }
+    if (n == 0)
+        return;
+    if (n == 1)
+    {
+        lengths[syms[0]] = 1;
+        return;
+    }
+
+    // least important symbols first: lower frequency, then lower symbol value
+    sort(syms, syms + n, [&](int a, int b)
+         { return freq[a] != freq[b] ? freq[a] < freq[b] : a < b; });
+
+    // Kraft sum scaled by 2^maxLen; a valid prefix code needs kraft <= full
+    const uint64_t full = uint64_t(1) << maxLen;
+    unsigned len[256] = {};
+    uint64_t kraft = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        int s = syms[i];
+        len[s] = min(depths[s], maxLen);
+        kraft += uint64_t(1) << (maxLen - len[s]);
+    }
+
+    // Clamping over-subscribes the code space: pay it back by lengthening
+    // the least frequent of the longest codes still below maxLen
+    while (kraft > full)
+    {
+        unsigned longest = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            if (len[syms[i]] < maxLen)
+                longest = max(longest, len[syms[i]]);
+        }
+        for (size_t i = 0; i < n; ++i)
+        {
+            int s = syms[i];
+            if (len[s] == longest)
+            {
+                kraft -= uint64_t(1) << (maxLen - len[s] - 1);
+                len[s]++;
+                break;
+            }
+        }
+    }
+
+    // Spend any code space left over on the most frequent symbols
+    for (size_t i = n; i-- > 0;)
+    {
+        int s = syms[i];
+        while (len[s] > 1 && kraft + (uint64_t(1) << (maxLen - len[s])) <= full)
+        {
+            kraft += uint64_t(1) << (maxLen - len[s]);
+            len[s]--;
+        }
+    }
+
+    // Shortest lengths go to the most frequent symbols
+    unsigned sorted[256];
+    for (size_t i = 0; i < n; ++i)
+        sorted[i] = len[syms[i]];
+    sort(sorted, sorted + n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        lengths[syms[n - 1 - i]] = static_cast<uint8_t>(sorted[i]);
+    }
+}
+
+bool HuffmanCanonical::assignCodes(const uint8_t lengths[256], uint32_t codes[256])
+{
+    const unsigned L = kMaxMaxCodeLength;
+    uint32_t count[L + 1] = {};
+    for (int s = 0; s < 256; ++s)
+    {
+        codes[s] = 0;
+        if (lengths[s] > L)
+            return false;
+        count[lengths[s]]++;
+    }
+    count[0] = 0;
+
+    uint64_t kraft = 0;
+    for (unsigned bits = 1; bits <= L; ++bits)
+        kraft += uint64_t(count[bits]) << (L - bits);
+    if (kraft > (uint64_t(1) << L))
+        return false;
+
+    uint32_t next[L + 1] = {};
+    uint32_t code = 0;
+    for (unsigned bits = 1; bits <= L; ++bits)
+    {
+        code = (code + count[bits - 1]) << 1;
+        next[bits] = code;
+    }
+    for (int s = 0; s < 256; ++s)
+    {
+        if (lengths[s] != 0)
+            codes[s] = next[lengths[s]]++;
+    }
+    return true;
+}
+
+void HuffmanEncodeTable::build(const uint32_t codes[256], const uint8_t lengths[256])
+{
+    for (int s = 0; s < 256; ++s)
+    {
+        table_[s] = Entry{codes[s], lengths[s]};
+    }
+}
+
+uint64_t HuffmanEncodeTable::encodedBits(const uint64_t freq[256]) const
+{
+    uint64_t bits = 0;
+    for (int s = 0; s < 256; ++s)
+    {
+        bits += freq[s] * table_[s].len;
+    }
+    return bits;
+}
+
+size_t HuffmanEncodeTable::encode(const unsigned char *data, size_t size, unsigned char *out) const
+{
+    // codes are at most 15 bits: three of them plus the <= 7 bits left
+    // over from the previous flush fit in the 64-bit accumulator
+    static_assert(3 * HuffmanCanonical::kMaxMaxCodeLength + 7 <= 57, "accumulator overflow");
+    BitWriter bw(out);
+    size_t i = 0;
+    for (; i + 3 <= size; i += 3)
+    {
+        const Entry &a = table_[data[i]];
+        const Entry &b = table_[data[i + 1]];
+        const Entry &c = table_[data[i + 2]];
+        bw.put(a.code, a.len);
+        bw.put(b.code, b.len);
+        bw.put(c.code, c.len);
+        bw.flush();
+    }
+    for (; i < size; ++i)
+    {
+        const Entry &a = table_[data[i]];
+        bw.put(a.code, a.len);
+    }
+    return static_cast<size_t>(bw.finish() - out);
+}
+
+bool HuffmanDecodeTable::build(const uint32_t codes[256], const uint8_t lengths[256])
+{
+    const unsigned P = kPrimaryBits;
+    primary_.assign(size_t(1) << P, Entry{0, 0, 0, 0, 0, 0, 0});
+    secondary_.clear();
+
+    // width of the secondary table needed under each primary prefix
+    vector<uint8_t> subBits(size_t(1) << P, 0);
+
+    for (int s = 0; s < 256; ++s)
+    {
+        unsigned len = lengths[s];
+        if (len == 0)
+            continue;
+        if (len > kMaxCodeLength)
+            return false;
+        if (len <= P)
+        {
+            // short code: fill every index that starts with it
+            uint32_t first = codes[s] << (P - len);
+            uint32_t count = uint32_t(1) << (P - len);
+            for (uint32_t i = first; i < first + count; ++i)
+            {
+                primary_[i] = Entry{static_cast<uint8_t>(s), 0, static_cast<uint8_t>(len),
+                                    static_cast<uint8_t>(len), 1, 0, 0};
+            }
+        }
+        else
+        {
+            uint32_t prefix = codes[s] >> (len - P);
+            subBits[prefix] = max<uint8_t>(subBits[prefix], static_cast<uint8_t>(len - P));
+        }
+    }
+
+    // allocate secondary tables for long-code prefixes
+    for (uint32_t prefix = 0; prefix < subBits.size(); ++prefix)
+    {
+        if (subBits[prefix] == 0)
+            continue;
+        primary_[prefix].count = 0;
+        primary_[prefix].subBits = subBits[prefix];
+        primary_[prefix].sub = static_cast<uint32_t>(secondary_.size());
+        secondary_.resize(secondary_.size() + (size_t(1) << subBits[prefix]), SubEntry{0, 0});
+    }
+    for (int s = 0; s < 256; ++s)
+    {
+        unsigned len = lengths[s];
+        if (len <= P)
+            continue;
+        uint32_t prefix = codes[s] >> (len - P);
+        const Entry &e = primary_[prefix];
+        unsigned rest = len - P;
+        uint32_t suffix = codes[s] & ((uint32_t(1) << rest) - 1);
+        uint32_t first = suffix << (e.subBits - rest);
+        uint32_t count = uint32_t(1) << (e.subBits - rest);
+        for (uint32_t i = first; i < first + count; ++i)
+        {
+            secondary_[e.sub + i] = SubEntry{static_cast<uint8_t>(s), static_cast<uint8_t>(len)};
+        }
+    }
+
+    // pair up short codes: if the bits left after the first symbol hold a
+    // complete second code, resolve both with the same lookup
+    const uint32_t mask = (uint32_t(1) << P) - 1;
+    vector<Entry> single(primary_);
+    for (uint32_t i = 0; i < primary_.size(); ++i)
+    {
+        Entry &e = primary_[i];
+        if (e.count != 1 || e.len0 >= P)
+            continue;
+        const Entry &next = single[(i << e.len0) & mask];
+        if (next.count == 1 && next.len0 <= P - e.len0)
+        {
+            e.sym1 = next.sym0;
+            e.lenAll = static_cast<uint8_t>(e.len0 + next.len0);
+            e.count = 2;
+        }
+    }
+    return true;
+}
+
+inline bool HuffmanDecodeTable::step(BitReader &br, size_t &bitsLeft, char *&o) const
+{
+    const Entry &e = primary_[br.peek(kPrimaryBits)];
+    if (e.count != 0)
+    {
+        // one or two symbols alike: lenAll == len0 and sym1 is scratch when
+        // count == 1, and the caller leaves room for the extra byte
+        o[0] = static_cast<char>(e.sym0);
+        o[1] = static_cast<char>(e.sym1);
+        o += e.count;
+        br.consume(e.lenAll);
+        bitsLeft -= e.lenAll;
+    }
+    else
+    {
+        if (e.subBits == 0)
+            return false;
+        uint32_t idx = br.peek(kPrimaryBits + e.subBits) & ((uint32_t(1) << e.subBits) - 1);
+        const SubEntry &s = secondary_[e.sub + idx];
+        if (s.len == 0)
+            return false;
+        *o++ = static_cast<char>(s.sym);
+        br.consume(s.len);
+        bitsLeft -= s.len;
+    }
+    return true;
+}
+
+bool HuffmanDecodeTable::decodeTail(BitReader &br, size_t bitsLeft, char *o, char *end) const
+{
+    const unsigned P = kPrimaryBits;
+    while (o < end)
+    {
+        br.refill();
+        const Entry &e = primary_[br.peek(P)];
+        if (e.count == 2 && end - o >= 2)
+        {
+            if (e.lenAll > bitsLeft)
+                return false;
+            o[0] = static_cast<char>(e.sym0);
+            o[1] = static_cast<char>(e.sym1);
+            o += 2;
+            br.consume(e.lenAll);
+            bitsLeft -= e.lenAll;
+        }
+        else if (e.count != 0)
+        {
+            if (e.len0 > bitsLeft)
+                return false;
+            *o++ = static_cast<char>(e.sym0);
+            br.consume(e.len0);
+            bitsLeft -= e.len0;
+        }
+        else
+        {
+            if (e.subBits == 0)
+                return false;
+            uint32_t idx = br.peek(P + e.subBits) & ((uint32_t(1) << e.subBits) - 1);
+            const SubEntry &s = secondary_[e.sub + idx];
+            if (s.len == 0 || s.len > bitsLeft)
+                return false;
+            *o++ = static_cast<char>(s.sym);
+            br.consume(s.len);
+            bitsLeft -= s.len;
+        }
+    }
+    return true;
+}
+
+bool HuffmanDecodeTable::decode(const unsigned char *payload, size_t payloadSize, size_t totalBits,
+                                char *out, size_t outSize) const
+{
+    BitReader br(payload, payloadSize);
+    return decodeTail(br, totalBits, out, out + outSize);
+}
+
+bool HuffmanDecodeTable::decodeStreams(unsigned n, const unsigned char *const payload[],
+                                       const size_t payloadSize[], const size_t totalBits[],
+                                       char *const out[], const size_t outSize[]) const
+{
+    if (n == 0 || n > kMaxStreams)
+        return false;
+
+    BitReader br[kMaxStreams];
+    size_t bitsLeft[kMaxStreams];
+    char *o[kMaxStreams];
+    char *end[kMaxStreams];
+    for (unsigned i = 0; i < n; ++i)
+    {
+        br[i] = BitReader(payload[i], payloadSize[i]);
+        bitsLeft[i] = totalBits[i];
+        o[i] = out[i];
+        end[i] = out[i] + outSize[i];
+    }
+
+    // A refill guarantees 56 bits: enough for three lookups of at most 15
+    // bits, which emit at most six symbols. While every stream has that much
+    // input and output left, no per-symbol bounds checks are needed.
+    const size_t kRoundBits = 3 * kMaxCodeLength;
+    const ptrdiff_t kRoundSymbols = 6;
+    static_assert(3 * kMaxCodeLength <= 56, "round does not fit one refill");
+    for (;;)
+    {
+        bool ready = true;
+        for (unsigned i = 0; i < n; ++i)
+            ready &= bitsLeft[i] >= kRoundBits && end[i] - o[i] >= kRoundSymbols;
+        if (!ready)
+            break;
+        for (unsigned i = 0; i < n; ++i)
+            br[i].refill();
+        for (int k = 0; k < 3; ++k)
+        {
+            for (unsigned i = 0; i < n; ++i)
+            {
+                if (!step(br[i], bitsLeft[i], o[i]))
+                    return false;
+            }
+        }
+    }
+
+    for (unsigned i = 0; i < n; ++i)
+    {
+        if (!decodeTail(br[i], bitsLeft[i], o[i], end[i]))
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,150 @@
+/*
+ * HuffmanTable.h
+ *
+ * Code tables shared by the Huffman encoder and decoder.
+ *
+ * HuffmanCanonical builds the Huffman tree, turns its depths into
+ * length-limited code lengths and assigns canonical codes from them, so
+ * only the lengths need to be stored in the container and the decoder
+ * never rebuilds a tree.
+ *
+ * The length limit is a heuristic, not package-merge: depths are clamped
+ * to the limit and the Kraft excess is repaid by lengthening the rarest of
+ * the longest codes, then leftover code space goes back to the most
+ * frequent symbols. The result is a valid prefix code but not always the
+ * optimal length-limited one; the loss only shows when the tree is deeper
+ * than the limit, which is rare at the default of 12 bits.
+ *
+ * HuffmanEncodeTable packs codes word-at-a-time through a 64-bit BitWriter
+ * into a preallocated buffer.
+ *
+ * HuffmanDecodeTable is the table-driven decoder. Instead of walking tree
+ * nodes one bit at a time, it peeks kPrimaryBits bits from a 64-bit
+ * BitReader and resolves up to two symbols with a single lookup. Codes
+ * longer than kPrimaryBits go through a per-prefix secondary table.
+ * decodeStreams() runs several independent bitstreams through the same
+ * loop, so their serial bit-reader dependency chains overlap in the CPU.
+ */
+
+#ifndef HUFFMANTABLE_H
+#define HUFFMANTABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class BitReader;
+
+class HuffmanCanonical
+{
+public:
+    // Bounds for the configurable maximum code length. 8 bits is the least
+    // that can hold 256 symbols; 15 keeps lengths in a nibble and decoder
+    // tables small enough to stay cache-resident.
+    static const unsigned kMinMaxCodeLength = 8;
+    static const unsigned kMaxMaxCodeLength = 15;
+    static const unsigned kDefaultMaxCodeLength = 12;
+
+    // Build the Huffman tree for freq (0 = symbol unused) with a min-heap in
+    // O(k log k) and turn its leaf depths into code lengths <= maxLen
+    // (clamped to kMinMaxCodeLength..kMaxMaxCodeLength).
+    // Tie-breaking: nodes of equal weight are merged leaves first, leaves in
+    // ascending symbol order, then internal nodes in creation order. This
+    // keeps the tree shallow and makes the result fully deterministic.
+    static void buildCodeLengths(const uint64_t freq[256], unsigned maxLen, uint8_t lengths[256]);
+
+    // Clamp tree depths (0 = symbol unused) to maxLen while keeping the
+    // Kraft sum <= 1, then hand the shortest lengths to the most frequent
+    // symbols (a heuristic, see above: not always optimal). Ties are broken by symbol value so the result is
+    // deterministic. A lone symbol gets length 1.
+    static void limitCodeLengths(const uint64_t freq[256], const unsigned depths[256],
+                                 unsigned maxLen, uint8_t lengths[256]);
+
+    // Assign canonical codes: shorter codes first, then by symbol value.
+    // Returns false if the lengths over-subscribe the code space or any
+    // length exceeds kMaxMaxCodeLength.
+    static bool assignCodes(const uint8_t lengths[256], uint32_t codes[256]);
+
+private:
+    // Collect the depth of every leaf (symbol) in the tree
+    static void computeDepths(const class NodeLetterTree &tree, unsigned depths[256]);
+};
+
+class HuffmanEncodeTable
+{
+public:
+    // Bytes of slack the output buffer needs past the encoded payload
+    static const size_t kOutputSlack = 8;
+
+    // Flat per-byte (code, length) table from canonical codes
+    void build(const uint32_t codes[256], const uint8_t lengths[256]);
+
+    // Number of payload bits needed to encode data with this table
+    uint64_t encodedBits(const uint64_t freq[256]) const;
+
+    // Pack the codes of data[0..size) MSB first into out, which must hold
+    // ceil(encodedBits / 8) + kOutputSlack bytes. Returns bytes produced.
+    size_t encode(const unsigned char *data, size_t size, unsigned char *out) const;
+
+private:
+    struct Entry
+    {
+        uint32_t code;
+        uint32_t len;
+    };
+    Entry table_[256];
+};
+
+class HuffmanDecodeTable
+{
+public:
+    static const unsigned kPrimaryBits = 11;
+    // Longest code the table can hold
+    static const unsigned kMaxCodeLength = HuffmanCanonical::kMaxMaxCodeLength;
+    // Most sub-streams decodeStreams() advances together
+    static const unsigned kMaxStreams = 8;
+
+    // Build the lookup tables from per-byte codes (MSB-first, right-aligned
+    // in codes[s]) and their lengths (0 = symbol unused). Incomplete codes
+    // are allowed; unused bit patterns decode as errors. Returns false if
+    // any code is longer than kMaxCodeLength.
+    bool build(const uint32_t codes[256], const uint8_t lengths[256]);
+
+    // Decode exactly outSize symbols from the first totalBits bits of the
+    // payload into out. Returns false if the payload is truncated or invalid.
+    bool decode(const unsigned char *payload, size_t payloadSize, size_t totalBits,
+                char *out, size_t outSize) const;
+
+    // Same as n calls to decode(), one per sub-stream i, but interleaved:
+    // every round advances all n bit readers before the next lookup.
+    bool decodeStreams(unsigned n, const unsigned char *const payload[], const size_t payloadSize[],
+                       const size_t totalBits[], char *const out[], const size_t outSize[]) const;
+
+private:
+    // One lookup (one or two symbols) without bounds checks
+    bool step(BitReader &br, size_t &bitsLeft, char *&o) const;
+    // Bounds-checked loop up to the end of the output
+    bool decodeTail(BitReader &br, size_t bitsLeft, char *o, char *end) const;
+
+    struct Entry
+    {
+        uint8_t sym0;    // first decoded symbol
+        uint8_t sym1;    // second decoded symbol (count == 2)
+        uint8_t len0;    // bits used by sym0
+        uint8_t lenAll;  // bits used by sym0 + sym1
+        uint8_t count;   // symbols resolved here; 0 = go to secondary table
+        uint8_t subBits; // width of the secondary table (count == 0)
+        uint32_t sub;    // offset of the secondary table
+    };
+
+    struct SubEntry
+    {
+        uint8_t sym;
+        uint8_t len; // full code length, 0 = invalid
+    };
+
+    std::vector<Entry> primary_;
+    std::vector<SubEntry> secondary_;
+};
+
+#endif // HUFFMANTABLE_H
@@ -0,0 +1,348 @@
+#include "KeyStream.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KEYSTREAM_X86 1
+#endif
+
+using namespace std;
+
+namespace
+{
+    const int kAlphabetSize = 52;
+
+    // How a data byte and a key byte are combined
+    enum class Combine
+    {
+        Xor,
+        Add, // mod 256
+        Sub, // mod 256
+    };
+
+    // Key repeated to period bytes (a multiple of the key length, at least
+    // one vector) plus one more vector, so key bytes for any position
+    // k < period can be loaded as pattern[k..k+width)
+    struct Pattern
+    {
+        vector<unsigned char> bytes;
+        size_t period;
+
+        Pattern(const unsigned char *key, size_t keyLen, size_t width)
+        {
+            period = keyLen * ((width + keyLen - 1) / keyLen);
+            bytes.resize(period + width);
+            for (size_t i = 0; i < bytes.size(); ++i)
+                bytes[i] = key[i % keyLen];
+        }
+
+        void advance(size_t &k, size_t width) const
+        {
+            k += width;
+            if (k >= period)
+                k -= period;
+        }
+    };
+
+    // ====== Scalar ======
+
+    template <Combine Op>
+    void combineScalar(const unsigned char *in, unsigned char *out, size_t size, const unsigned char *key,
+                       size_t keyLen, size_t k)
+    {
+        for (size_t i = 0; i < size; ++i)
+        {
+            if (Op == Combine::Xor)
+                out[i] = in[i] ^ key[k];
+            else if (Op == Combine::Add)
+                out[i] = static_cast<unsigned char>(in[i] + key[k]);
+            else
+                out[i] = static_cast<unsigned char>(in[i] - key[k]);
+            if (++k == keyLen)
+                k = 0;
+        }
+    }
+
+    // Byte -> alphabet position (-1 for non-letters) and position -> letter
+    // with the alphabet twice, so p + s and p - s + 52 need no modulo. 128
+    // entries keep a non-letter (p = -1) inside the table.
+    struct LetterTables
+    {
+        signed char position[256];
+        unsigned char letter[128];
+
+        LetterTables()
+        {
+            const char alphabet[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+            memset(position, -1, sizeof(position));
+            memset(letter, 0, sizeof(letter));
+            for (int i = 0; i < kAlphabetSize; ++i)
+            {
+                position[static_cast<unsigned char>(alphabet[i])] = static_cast<signed char>(i);
+                letter[i] = letter[i + kAlphabetSize] = static_cast<unsigned char>(alphabet[i]);
+            }
+        }
+    };
+
+    const LetterTables kTables;
+
+    // Non-letters are OR-ed into `bad` and checked once, outside the loop
+    template <int Sign>
+    bool lettersScalar(const unsigned char *in, unsigned char *out, size_t size, const unsigned char *shifts,
+                       size_t keyLen, size_t k)
+    {
+        const int base = Sign > 0 ? 0 : kAlphabetSize;
+        int bad = 0;
+        for (size_t i = 0; i < size; ++i)
+        {
+            int p = kTables.position[in[i]];
+            bad |= p;
+            out[i] = kTables.letter[(base + p + Sign * shifts[k]) & 127];
+            if (++k == keyLen)
+                k = 0;
+        }
+        return bad >= 0;
+    }
+
+    bool lettersScalarDir(const unsigned char *in, unsigned char *out, size_t size, const unsigned char *shifts,
+                          size_t keyLen, size_t k, bool decrypt)
+    {
+        return decrypt ? lettersScalar<-1>(in, out, size, shifts, keyLen, k)
+                       : lettersScalar<+1>(in, out, size, shifts, keyLen, k);
+    }
+
+#ifdef KEYSTREAM_X86
+    // ====== SSE2 ======
+
+    template <Combine Op>
+    __attribute__((target("sse2"))) void combineSse2(const unsigned char *in, unsigned char *out, size_t size,
+                                                     const unsigned char *key, size_t keyLen, size_t k)
+    {
+        const size_t W = 16;
+        if (size < 4 * W)
+            return combineScalar<Op>(in, out, size, key, keyLen, k);
+        Pattern pat(key, keyLen, W);
+        size_t i = 0;
+        for (; i + W <= size; i += W)
+        {
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pat.bytes.data() + k));
+            if (Op == Combine::Xor)
+                d = _mm_xor_si128(d, x);
+            else if (Op == Combine::Add)
+                d = _mm_add_epi8(d, x);
+            else
+                d = _mm_sub_epi8(d, x);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), d);
+            pat.advance(k, W);
+        }
+        combineScalar<Op>(in + i, out + i, size - i, key, keyLen, k % keyLen);
+    }
+
+    // Letters of 16 bytes: positions from two range checks, shift, wrap
+    // into 0..51 and back to ASCII. Non-letter lanes are set in bad.
+    __attribute__((target("sse2"))) inline __m128i lettersSse2Vec(__m128i c, __m128i s, bool decrypt, __m128i &bad)
+    {
+        const __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('a' - 1)),
+                                            _mm_cmplt_epi8(c, _mm_set1_epi8('z' + 1)));
+        const __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('A' - 1)),
+                                            _mm_cmplt_epi8(c, _mm_set1_epi8('Z' + 1)));
+        bad = _mm_or_si128(bad, _mm_andnot_si128(_mm_or_si128(lower, upper), _mm_set1_epi8(-1)));
+
+        __m128i p = _mm_or_si128(_mm_and_si128(lower, _mm_sub_epi8(c, _mm_set1_epi8('a'))),
+                                 _mm_and_si128(upper, _mm_sub_epi8(c, _mm_set1_epi8('A' - 26))));
+        if (decrypt)
+        {
+            p = _mm_sub_epi8(p, s);
+            p = _mm_add_epi8(p, _mm_and_si128(_mm_cmplt_epi8(p, _mm_setzero_si128()), _mm_set1_epi8(kAlphabetSize)));
+        }
+        else
+        {
+            p = _mm_add_epi8(p, s);
+            p = _mm_sub_epi8(p, _mm_and_si128(_mm_cmpgt_epi8(p, _mm_set1_epi8(kAlphabetSize - 1)),
+                                              _mm_set1_epi8(kAlphabetSize)));
+        }
+        const __m128i isLower = _mm_cmplt_epi8(p, _mm_set1_epi8(26));
+        const __m128i add = _mm_or_si128(_mm_and_si128(isLower, _mm_set1_epi8('a')),
+                                         _mm_andnot_si128(isLower, _mm_set1_epi8('A' - 26)));
+        return _mm_add_epi8(p, add);
+    }
+
+    __attribute__((target("sse2"))) bool lettersSse2(const unsigned char *in, unsigned char *out, size_t size,
+                                                     const unsigned char *shifts, size_t keyLen, size_t k,
+                                                     bool decrypt)
+    {
+        const size_t W = 16;
+        if (size < 4 * W)
+            return lettersScalarDir(in, out, size, shifts, keyLen, k, decrypt);
+        Pattern pat(shifts, keyLen, W);
+        __m128i bad = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + W <= size; i += W)
+        {
+            __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+            __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pat.bytes.data() + k));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), lettersSse2Vec(c, s, decrypt, bad));
+            pat.advance(k, W);
+        }
+        bool ok = _mm_movemask_epi8(bad) == 0;
+        return lettersScalarDir(in + i, out + i, size - i, shifts, keyLen, k % keyLen, decrypt) && ok;
+    }
+
+    // ====== AVX2 ======
+
+    template <Combine Op>
+    __attribute__((target("avx2"))) void combineAvx2(const unsigned char *in, unsigned char *out, size_t size,
+                                                     const unsigned char *key, size_t keyLen, size_t k)
+    {
+        const size_t W = 32;
+        if (size < 4 * W)
+            return combineScalar<Op>(in, out, size, key, keyLen, k);
+        Pattern pat(key, keyLen, W);
+        size_t i = 0;
+        for (; i + W <= size; i += W)
+        {
+            __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pat.bytes.data() + k));
+            if (Op == Combine::Xor)
+                d = _mm256_xor_si256(d, x);
+            else if (Op == Combine::Add)
+                d = _mm256_add_epi8(d, x);
+            else
+                d = _mm256_sub_epi8(d, x);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), d);
+            pat.advance(k, W);
+        }
+        combineScalar<Op>(in + i, out + i, size - i, key, keyLen, k % keyLen);
+    }
+
+    // Same steps as lettersSse2Vec on 32 bytes
+    __attribute__((target("avx2"))) inline __m256i lettersAvx2Vec(__m256i c, __m256i s, bool decrypt, __m256i &bad)
+    {
+        const __m256i lower = _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('a' - 1)),
+                                               _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), c));
+        const __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('A' - 1)),
+                                               _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), c));
+        bad = _mm256_or_si256(bad, _mm256_andnot_si256(_mm256_or_si256(lower, upper), _mm256_set1_epi8(-1)));
+
+        __m256i p = _mm256_or_si256(_mm256_and_si256(lower, _mm256_sub_epi8(c, _mm256_set1_epi8('a'))),
+                                    _mm256_and_si256(upper, _mm256_sub_epi8(c, _mm256_set1_epi8('A' - 26))));
+        if (decrypt)
+        {
+            p = _mm256_sub_epi8(p, s);
+            p = _mm256_add_epi8(p, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_setzero_si256(), p),
+                                                    _mm256_set1_epi8(kAlphabetSize)));
+        }
+        else
+        {
+            p = _mm256_add_epi8(p, s);
+            p = _mm256_sub_epi8(p, _mm256_and_si256(_mm256_cmpgt_epi8(p, _mm256_set1_epi8(kAlphabetSize - 1)),
+                                                    _mm256_set1_epi8(kAlphabetSize)));
+        }
+        const __m256i isLower = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), p);
+        return _mm256_add_epi8(p, _mm256_blendv_epi8(_mm256_set1_epi8('A' - 26), _mm256_set1_epi8('a'), isLower));
+    }
+
+    __attribute__((target("avx2"))) bool lettersAvx2(const unsigned char *in, unsigned char *out, size_t size,
+                                                     const unsigned char *shifts, size_t keyLen, size_t k,
+                                                     bool decrypt)
+    {
+        const size_t W = 32;
+        if (size < 4 * W)
+            return lettersScalarDir(in, out, size, shifts, keyLen, k, decrypt);
+        Pattern pat(shifts, keyLen, W);
+        __m256i bad = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + W <= size; i += W)
+        {
+            __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+            __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pat.bytes.data() + k));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), lettersAvx2Vec(c, s, decrypt, bad));
+            pat.advance(k, W);
+        }
+        bool ok = _mm256_movemask_epi8(bad) == 0;
+        return lettersScalarDir(in + i, out + i, size - i, shifts, keyLen, k % keyLen, decrypt) && ok;
+    }
+#endif
+
+    // ====== Dispatch ======
+
+    using CombineFn = void (*)(const unsigned char *, unsigned char *, size_t, const unsigned char *, size_t,
+                               size_t);
+    using LettersFn = bool (*)(const unsigned char *, unsigned char *, size_t, const unsigned char *, size_t,
+                               size_t, bool);
+
+    struct Kernels
+    {
+        CombineFn xorFn;
+        CombineFn addFn;
+        CombineFn subFn;
+        LettersFn lettersFn;
+        const char *name;
+    };
+
+    // Best kernels this CPU supports. KEYSTREAM_ISA=sse2|scalar forces a
+    // lower level, to compare them on the same machine.
+    Kernels pickKernels()
+    {
+        const char *force = getenv("KEYSTREAM_ISA");
+        string want = force ? force : "";
+#ifdef KEYSTREAM_X86
+        __builtin_cpu_init();
+        if (want.empty() || want == "avx2")
+        {
+            if (__builtin_cpu_supports("avx2"))
+                return {combineAvx2<Combine::Xor>, combineAvx2<Combine::Add>, combineAvx2<Combine::Sub>,
+                        lettersAvx2, "avx2"};
+        }
+        if (want != "scalar" && __builtin_cpu_supports("sse2"))
+            return {combineSse2<Combine::Xor>, combineSse2<Combine::Add>, combineSse2<Combine::Sub>,
+                    lettersSse2, "sse2"};
+#endif
+        return {combineScalar<Combine::Xor>, combineScalar<Combine::Add>, combineScalar<Combine::Sub>,
+                lettersScalarDir, "scalar"};
+    }
+
+    const Kernels &kernels()
+    {
+        static const Kernels k = pickKernels();
+        return k;
+    }
+}
+
+void KeyStream::xorBytes(const char *in, char *out, size_t size, const string &key, size_t offset)
+{
+    if (key.empty())
+        throw runtime_error("KeyStream: empty key");
+    kernels().xorFn(reinterpret_cast<const unsigned char *>(in), reinterpret_cast<unsigned char *>(out), size,
+                    reinterpret_cast<const unsigned char *>(key.data()), key.size(), offset % key.size());
+}
+
+void KeyStream::addBytes(const char *in, char *out, size_t size, const string &key, size_t offset, bool subtract)
+{
+    if (key.empty())
+        throw runtime_error("KeyStream: empty key");
+    const Kernels &k = kernels();
+    (subtract ? k.subFn : k.addFn)(reinterpret_cast<const unsigned char *>(in),
+                                   reinterpret_cast<unsigned char *>(out), size,
+                                   reinterpret_cast<const unsigned char *>(key.data()), key.size(),
+                                   offset % key.size());
+}
+
+bool KeyStream::shiftLetters(const char *in, char *out, size_t size, const unsigned char *shifts, size_t keyLen,
+                             size_t offset, bool decrypt)
+{
+    if (keyLen == 0)
+        throw runtime_error("KeyStream: empty key");
+    return kernels().lettersFn(reinterpret_cast<const unsigned char *>(in), reinterpret_cast<unsigned char *>(out),
+                               size, shifts, keyLen, offset % keyLen, decrypt);
+}
+
+const char *KeyStream::isa()
+{
+    return kernels().name;
+}
@@ -0,0 +1,44 @@
+/*
+ * KeyStream.h
+ *
+ * Kernels that combine data with a repeating key: XOR (clitool --enc-alg
+ * xor), byte-wise Vigenere (addition mod 256) and the letters-only
+ * Vigenere shift.
+ *
+ * The key is pre-expanded into a pattern at least one vector long, so a
+ * whole vector of key bytes is a single unaligned load whatever the key
+ * length; the key position then advances by the vector width modulo the
+ * pattern length. SSE2 and AVX2 versions are picked once at startup from
+ * the CPU features, with a scalar fallback on other machines.
+ */
+
+#ifndef KEYSTREAM_H
+#define KEYSTREAM_H
+
+#include <cstddef>
+#include <string>
+
+class KeyStream
+{
+public:
+    // out[i] = in[i] ^ key[(offset + i) % key.size()] for i < size.
+    // in == out is allowed. key must not be empty.
+    static void xorBytes(const char *in, char *out, size_t size, const std::string &key, size_t offset = 0);
+
+    // Byte-wise Vigenere: out[i] = in[i] +/- key[(offset + i) % key.size()]
+    // mod 256, subtracting when subtract is set. in == out is allowed.
+    static void addBytes(const char *in, char *out, size_t size, const std::string &key, size_t offset,
+                         bool subtract);
+
+    // Vigenere over the 52-letter alphabet (a-z = 0-25, A-Z = 26-51):
+    // out[i] = letter(pos(in[i]) +/- shifts[(offset + i) % keyLen]) mod 52,
+    // subtracting when decrypt is set. shifts are 0-51. Returns false if
+    // some input byte is not a letter; out is unspecified then.
+    static bool shiftLetters(const char *in, char *out, size_t size, const unsigned char *shifts, size_t keyLen,
+                             size_t offset, bool decrypt);
+
+    // Instruction set the kernels run with: "avx2", "sse2" or "scalar"
+    static const char *isa();
+};
+
+#endif // KEYSTREAM_H
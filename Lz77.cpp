@@ -0,0 +1,288 @@
+#include "Lz77.h"
+#include "Huffman.h"
+#include "Varint.h"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+using namespace std;
+
+namespace
+{
+    const char kMagic[4] = {'L', 'Z', 'H', 'V'};
+    const uint8_t kFormatVersion = 1;
+
+    const unsigned kMaxHashBits = 15;
+    const size_t kNoPos = SIZE_MAX;
+
+    // Literals, literal runs, match lengths, distances
+    const int kSections = 4;
+
+    struct Sequences
+    {
+        vector<char> streams[kSections];
+        size_t count;
+
+        void clear()
+        {
+            for (auto &s : streams)
+                s.clear();
+            count = 0;
+        }
+
+        void putVarint(int stream, uint64_t v)
+        {
+            char buf[Varint::kMaxBytes];
+            streams[stream].insert(streams[stream].end(), buf, Varint::store(buf, v));
+        }
+    };
+
+    // Hash heads and chain links for one block. Tables are sized to the
+    // block so small files do not pay for a full window.
+    class MatchFinder
+    {
+    public:
+        explicit MatchFinder(size_t blockSize)
+        {
+            hashBits_ = 8;
+            while (hashBits_ < kMaxHashBits && (size_t(1) << hashBits_) < blockSize)
+                hashBits_++;
+            size_t window = 256;
+            while (window < Lz77::kWindowSize && window < blockSize)
+                window <<= 1;
+            mask_ = window - 1;
+            head_.assign(size_t(1) << hashBits_, kNoPos);
+            chain_.assign(window, kNoPos);
+        }
+
+        // Greedy parse of p[0..n) into seq, trying up to depth candidates
+        // per position
+        void parse(const unsigned char *p, size_t n, unsigned depth, Sequences &seq)
+        {
+            fill(head_.begin(), head_.end(), kNoPos);
+            seq.clear();
+
+            size_t i = 0, anchor = 0;
+            while (n >= Lz77::kMinMatch && i <= n - Lz77::kMinMatch)
+            {
+                size_t best = 0, bestDist = 0;
+                size_t cand = head_[hash(p + i)];
+                for (unsigned d = 0; d < depth && cand != kNoPos && i - cand <= mask_; ++d)
+                {
+                    // a longer match must at least agree at the current best length
+                    if (p[cand + best] == p[i + best])
+                    {
+                        size_t len = matchLength(p + cand, p + i, p + n);
+                        if (len > best)
+                        {
+                            best = len;
+                            bestDist = i - cand;
+                            if (i + best == n)
+                                break;
+                        }
+                    }
+                    size_t next = chain_[cand & mask_];
+                    if (next == kNoPos || next >= cand)
+                        break; // slot reused by a newer position
+                    cand = next;
+                }
+                insert(p, i);
+
+                if (best < Lz77::kMinMatch)
+                {
+                    ++i;
+                    continue;
+                }
+                seq.streams[0].insert(seq.streams[0].end(), p + anchor, p + i);
+                seq.putVarint(1, i - anchor);
+                seq.putVarint(2, best - Lz77::kMinMatch);
+                seq.putVarint(3, bestDist - 1);
+                seq.count++;
+
+                // index the positions inside the match for later matches
+                size_t end = min(i + best, n - Lz77::kMinMatch + 1);
+                for (size_t j = i + 1; j < end; ++j)
+                    insert(p, j);
+                i += best;
+                anchor = i;
+            }
+            seq.streams[0].insert(seq.streams[0].end(), p + anchor, p + n);
+        }
+
+    private:
+        uint32_t hash(const unsigned char *p) const
+        {
+            uint32_t v;
+            memcpy(&v, p, sizeof(v));
+            return (v * 2654435761u) >> (32 - hashBits_);
+        }
+
+        void insert(const unsigned char *p, size_t i)
+        {
+            uint32_t h = hash(p + i);
+            chain_[i & mask_] = head_[h];
+            head_[h] = i;
+        }
+
+        // Length of the common prefix of a and b, b running up to end
+        static size_t matchLength(const unsigned char *a, const unsigned char *b, const unsigned char *end)
+        {
+            const unsigned char *start = b;
+            while (end - b >= 8)
+            {
+                uint64_t x, y;
+                memcpy(&x, a, sizeof(x));
+                memcpy(&y, b, sizeof(y));
+                if (x != y)
+                {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+                    return static_cast<size_t>(b - start) + (__builtin_ctzll(x ^ y) >> 3);
+#else
+                    return static_cast<size_t>(b - start) + (__builtin_clzll(x ^ y) >> 3);
+#endif
+                }
+                a += 8;
+                b += 8;
+            }
+            while (b < end && *a == *b)
+            {
+                a++;
+                b++;
+            }
+            return static_cast<size_t>(b - start);
+        }
+
+        unsigned hashBits_;
+        size_t mask_;
+        vector<size_t> head_;
+        vector<size_t> chain_;
+    };
+
+    // Parser state reused by every block of one container
+    struct BlockEncoder
+    {
+        BlockEncoder(size_t blockSize, unsigned depth)
+            : finder(blockSize), depth(max(1u, min(depth, Lz77::kMaxDepth))) {}
+
+        void operator()(const char *data, size_t size, vector<char> &body)
+        {
+            finder.parse(reinterpret_cast<const unsigned char *>(data), size, depth, seq);
+
+            char buf[Varint::kMaxBytes];
+            body.insert(body.end(), buf, Varint::store(buf, seq.count));
+            for (const auto &stream : seq.streams)
+            {
+                vector<char> section = Huffman::HuffmanCompression(stream);
+                body.insert(body.end(), buf, Varint::store(buf, section.size()));
+                body.insert(body.end(), section.begin(), section.end());
+            }
+        }
+
+        MatchFinder finder;
+        unsigned depth;
+        Sequences seq;
+    };
+
+    // Read the next varint of a decoded sequence stream
+    bool nextField(const vector<char> &stream, size_t &pos, uint64_t &v)
+    {
+        return Varint::load(stream.data(), pos, stream.size(), v) == Varint::kOk;
+    }
+
+    // Rebuild a block of rawSize bytes from its body
+    bool decodeBody(const char *base, size_t end, char *out, size_t rawSize)
+    {
+        size_t pos = 0;
+        uint64_t count;
+        if (Varint::load(base, pos, end, count) != Varint::kOk)
+            return false;
+
+        vector<char> streams[kSections];
+        for (auto &stream : streams)
+        {
+            uint64_t n;
+            if (Varint::load(base, pos, end, n) != Varint::kOk || n > end - pos)
+                return false;
+            stream = Huffman::HuffmanDecompression(vector<char>(base + pos, base + pos + n));
+            pos += n;
+        }
+        if (pos != end)
+            return false;
+
+        const vector<char> &literals = streams[0];
+        size_t o = 0, lit = 0, runPos = 0, lenPos = 0, distPos = 0;
+        for (uint64_t s = 0; s < count; ++s)
+        {
+            uint64_t run, len, dist;
+            if (!nextField(streams[1], runPos, run) || !nextField(streams[2], lenPos, len) ||
+                !nextField(streams[3], distPos, dist))
+                return false;
+            if (run > literals.size() - lit || run > rawSize - o)
+                return false;
+            // literals may be empty (data() null), and memcpy needs valid pointers
+            if (run)
+                memcpy(out + o, literals.data() + lit, run);
+            lit += run;
+            o += run;
+
+            len += Lz77::kMinMatch;
+            dist += 1;
+            if (dist > o || len > rawSize - o)
+                return false;
+            const char *from = out + o - dist;
+            if (dist >= len)
+            {
+                memcpy(out + o, from, len);
+            }
+            else
+            {
+                // overlapping copy repeats the last dist bytes
+                for (size_t k = 0; k < len; ++k)
+                    out[o + k] = from[k];
+            }
+            o += len;
+        }
+
+        size_t rest = literals.size() - lit;
+        if (rest != rawSize - o || runPos != streams[1].size() || lenPos != streams[2].size() ||
+            distPos != streams[3].size())
+            return false;
+        if (rest)
+            memcpy(out + o, literals.data() + lit, rest);
+        return true;
+    }
+}
+
+// min takes it by reference, so it needs a definition
+const unsigned Lz77::kMaxDepth;
+
+vector<char> Lz77::compress(const vector<char> &input, unsigned depth, size_t blockSize, const RangeFn &done)
+{
+    BlockEncoder encoder(blockSize == 0 ? input.size() : min(blockSize, input.size()), depth);
+    return FrameEncoder::encodeAll(input, kMagic, kFormatVersion, blockSize,
+                                   [&](const char *data, size_t size, vector<char> &body)
+                                   { encoder(data, size, body); },
+                                   done);
+}
+
+bool Lz77::decompress(const vector<char> &compressed, vector<char> &output)
+{
+    return FrameDecoder::decodeAll(compressed, kMagic, kFormatVersion, decodeBody, output);
+}
+
+bool Lz77::decompress(vector<char> &compressed, const RangeFn &reveal, vector<char> &output)
+{
+    return FrameDecoder::decodeAll(compressed, kMagic, kFormatVersion, decodeBody, reveal, output);
+}
+
+Lz77Encoder::Lz77Encoder(ByteSink sink, unsigned depth, size_t blockSize)
+    : frames_(std::move(sink), kMagic, kFormatVersion, blockSize,
+              [encoder = make_shared<BlockEncoder>(blockSize ? blockSize : FrameEncoder::kDefaultBlockSize, depth)](
+                  const char *data, size_t size, vector<char> &body)
+              { (*encoder)(data, size, body); })
+{
+}
+
+Lz77Decoder::Lz77Decoder(ByteSink sink)
+    : frames_(std::move(sink), kMagic, kFormatVersion, decodeBody)
+{
+}
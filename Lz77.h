@@ -0,0 +1,89 @@
+/*
+ * Lz77.h
+ *
+ * LZ77 front end for the Huffman coder. A hash-chain match finder turns
+ * each block into sequences of (literal run, match length, distance). The
+ * literals and the three sequence fields go to four separate byte streams,
+ * and each stream is Huffman-coded on its own, so every field gets a code
+ * fitted to its own statistics.
+ *
+ * The search depth (candidates tried per position) trades speed for ratio.
+ * Matches never cross block boundaries, so blocks decode independently.
+ *
+ * Container: the block framing of Frame.h with magic "LZHV". Block body:
+ *       sequences varint
+ *       4 sections, each a varint size followed by a Huffman container:
+ *         literals       literal bytes of every sequence, then the trailing literals
+ *         literal runs   varint per sequence: literals before the match
+ *         match lengths  varint per sequence: length - kMinMatch
+ *         distances      varint per sequence: distance - 1
+ */
+
+#ifndef LZ77_H
+#define LZ77_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "Frame.h"
+
+class Lz77
+{
+public:
+    static const unsigned kMinMatch = 4;
+    // Farthest a match may reach back
+    static const size_t kWindowSize = size_t(1) << 16;
+    static const unsigned kDefaultDepth = 16;
+    static const unsigned kMaxDepth = 4096;
+
+    // Compress the input; depth = candidates examined per position (1 is
+    // fastest), blockSize 0 = whole input as one block; blocks are at most
+    // FrameEncoder::kMaxBlockSize. done, if set, gets each finished frame
+    // (see FrameEncoder::encodeAll).
+    static std::vector<char> compress(const std::vector<char> &input,
+                                      unsigned depth = kDefaultDepth,
+                                      size_t blockSize = 0,
+                                      const RangeFn &done = nullptr);
+
+    // Decompress into output; returns false if the container is malformed
+    // (output is unspecified then)
+    static bool decompress(const std::vector<char> &compressed, std::vector<char> &output);
+    // Same for a still-transformed container, revealed frame by frame in
+    // place (see FrameDecoder::decodeAll)
+    static bool decompress(std::vector<char> &compressed, const RangeFn &reveal, std::vector<char> &output);
+};
+
+// Streaming compressor with the same interface as HuffmanEncoder
+class Lz77Encoder
+{
+public:
+    // blockSize 0 = FrameEncoder::kDefaultBlockSize
+    explicit Lz77Encoder(ByteSink sink, unsigned depth = Lz77::kDefaultDepth,
+                         size_t blockSize = FrameEncoder::kDefaultBlockSize);
+
+    void write(const char *data, size_t size) { frames_.write(data, size); }
+
+    // Compress the last partial block and close the container
+    void finish() { frames_.finish(); }
+
+private:
+    FrameEncoder frames_;
+};
+
+// Streaming decompressor with the same interface as HuffmanDecoder
+class Lz77Decoder
+{
+public:
+    explicit Lz77Decoder(ByteSink sink);
+
+    // Returns false once the input is known to be malformed
+    bool write(const char *data, size_t size) { return frames_.write(data, size); }
+
+    // True if the whole container, terminator included, was decoded
+    bool finish() { return frames_.finish(); }
+
+private:
+    FrameDecoder frames_;
+};
+
+#endif // LZ77_H
@@ -1,22 +1,74 @@
+/*
+ * NodeLetter.h
+ *
+ * Huffman tree stored as one flat array of nodes. Children are referenced
+ * by index instead of pointer, and a node is always added after its
+ * children, so the root is the last node and a single backwards pass over
+ * the array visits every parent before its children.
+ *
+ * A tree over 256 symbols never has more than 511 nodes, so the arena is a
+ * fixed-size array: building a tree allocates nothing and clear() frees it
+ * in O(1). One arena can be reused for every tree built on the same thread.
+ */
+
 #ifndef NODELETTER_H
 #define NODELETTER_H
+
+#include <cstddef>
+
 class NodeLetter
 {
 public:
+    static const int kNone = -1;
+
+    NodeLetter() : der(kNone), izq(kNone), id(0), letra('\0') {}
     NodeLetter(int identificador, char letra)
-        : der(nullptr), izq(nullptr), id(identificador), letra(letra) {}
+        : der(kNone), izq(kNone), id(identificador), letra(letra) {}
 
-    NodeLetter *der;
-    NodeLetter *izq;
+    bool isLeaf() const { return izq == kNone && der == kNone; }
+
+    int der; // index of the right child in the tree, kNone for leaves
+    int izq; // index of the left child
     int id;
     char letra;
 };
 
-void deleteTree(NodeLetter* node) {
-    if (!node) return;
-    deleteTree(node->izq);
-    deleteTree(node->der);
-    delete node;
-}
+class NodeLetterTree
+{
+public:
+    static const size_t kMaxNodes = 2 * 256 - 1;
+
+    NodeLetterTree() : size_(0) {}
+
+    // Append a node and return its index
+    int add(int id, char letra)
+    {
+        nodes_[size_] = NodeLetter(id, letra);
+        return static_cast<int>(size_++);
+    }
+
+    // Append an internal node over two existing nodes
+    int join(int id, int izq, int der)
+    {
+        int n = add(id, '\0');
+        nodes_[n].izq = izq;
+        nodes_[n].der = der;
+        return n;
+    }
+
+    void clear() { size_ = 0; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    // The last node added; only meaningful once the tree is complete
+    int root() const { return static_cast<int>(size_) - 1; }
+
+    NodeLetter &operator[](int i) { return nodes_[i]; }
+    const NodeLetter &operator[](int i) const { return nodes_[i]; }
+
+private:
+    NodeLetter nodes_[kMaxNodes];
+    size_t size_;
+};
 
-#endif
\ No newline at end of file
+#endif // NODELETTER_H
@@ -0,0 +1,199 @@
+/*
+ * Stats.h
+ *
+ * Optional timing and byte counters for the pipeline stages and the
+ * Huffman internals (clitool --stats).
+ *
+ * Every thread that records something gets its own Counters block, so
+ * recording never takes a lock or shares a cache line. The blocks are
+ * owned by a process-wide registry. When a short-lived thread (e.g. one
+ * of Huffman's block threads) exits, its counts are folded into a single
+ * retired block and its own is freed, so memory does not grow with every
+ * file; pool workers keep theirs for the per-worker report. snapshot()
+ * returns them once all workers have been joined. Time comes from
+ * steady_clock.
+ *
+ * Until enable() is called a StageTimer costs one relaxed atomic load and
+ * a predictable branch, so the probes stay compiled in.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class Stats
+{
+public:
+    enum class Stage
+    {
+        // Pipeline, per file (or per chunk with --stream). With fused -ce /
+        // -ud, Encrypt and Decrypt are per block and run inside Compress /
+        // Decompress, which leave that time out.
+        Read,
+        Compress,
+        Decompress,
+        Encrypt,
+        Decrypt,
+        Write,
+        // Huffman internals, nested inside Compress / Decompress
+        Histogram,
+        Tree,
+        Encode,
+        DecodeTable,
+        Decode,
+    };
+    static const int kStages = static_cast<int>(Stage::Decode) + 1;
+
+    struct Counters
+    {
+        uint64_t ns[kStages] = {};
+        uint64_t bytes[kStages] = {};
+        uint64_t calls[kStages] = {};
+        // Files finished on this thread and their sizes
+        uint64_t files = 0;
+        uint64_t inBytes = 0;
+        uint64_t outBytes = 0;
+        // Pool workers only: 1-based worker number, time alive and time in jobs
+        unsigned worker = 0;
+        uint64_t aliveNs = 0;
+        uint64_t busyNs = 0;
+    };
+
+    // Lowercase name, used as the key in reports
+    static const char *name(Stage stage)
+    {
+        static const char *const names[kStages] = {"read", "compress", "decompress", "encrypt", "decrypt", "write",
+                                                   "histogram", "tree", "encode", "decode_table", "decode"};
+        return names[static_cast<int>(stage)];
+    }
+
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+    static void enable() { enabled_.store(true, std::memory_order_relaxed); }
+
+    static uint64_t now()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                         std::chrono::steady_clock::now().time_since_epoch())
+                                         .count());
+    }
+
+    // Counters of the calling thread, registered on first use
+    static Counters &local()
+    {
+        thread_local Registration registration;
+        return *registration.counters;
+    }
+
+    static void add(Stage stage, uint64_t bytes, uint64_t ns)
+    {
+        Counters &c = local();
+        int s = static_cast<int>(stage);
+        c.ns[s] += ns;
+        c.bytes[s] += bytes;
+        c.calls[s]++;
+    }
+
+    // Copy of every thread's counters. Only exact once the threads that
+    // recorded them have been joined.
+    static std::vector<Counters> snapshot()
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        std::vector<Counters> all(1, retired());
+        for (const auto &c : threads_)
+            all.push_back(*c);
+        return all;
+    }
+
+private:
+    // Lives as long as its thread: registers the Counters on first use and
+    // retires them when the thread exits
+    struct Registration
+    {
+        Counters *counters = registerThread();
+        ~Registration() { retireThread(counters); }
+    };
+
+    static Counters *registerThread()
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        threads_.push_back(std::make_unique<Counters>());
+        return threads_.back().get();
+    }
+
+    // Sum of the threads that have exited, pool workers aside
+    static Counters &retired()
+    {
+        static Counters total;
+        return total;
+    }
+
+    static void retireThread(Counters *counters)
+    {
+        if (counters->worker)
+            return;
+        std::lock_guard<std::mutex> lk(mutex_);
+        Counters &total = retired();
+        for (int s = 0; s < kStages; ++s)
+        {
+            total.ns[s] += counters->ns[s];
+            total.bytes[s] += counters->bytes[s];
+            total.calls[s] += counters->calls[s];
+        }
+        total.files += counters->files;
+        total.inBytes += counters->inBytes;
+        total.outBytes += counters->outBytes;
+        for (auto it = threads_.begin(); it != threads_.end(); ++it)
+        {
+            if (it->get() == counters)
+            {
+                threads_.erase(it);
+                break;
+            }
+        }
+    }
+
+    inline static std::atomic<bool> enabled_{false};
+    inline static std::mutex mutex_;
+    inline static std::vector<std::unique_ptr<Counters>> threads_;
+};
+
+// Adds the lifetime of the scope to a stage when stats are enabled
+class StageTimer
+{
+public:
+    StageTimer(Stats::Stage stage, uint64_t bytes)
+        : stage_(stage), bytes_(bytes), start_(Stats::enabled() ? Stats::now() : 0) {}
+
+    ~StageTimer()
+    {
+        if (start_)
+            Stats::add(stage_, bytes_, Stats::now() - start_ - excluded_);
+    }
+
+    // For stages whose size is only known at the end, e.g. a read
+    void setBytes(uint64_t bytes) { bytes_ = bytes; }
+
+    // Time since construction, 0 when stats are disabled
+    uint64_t elapsed() const { return start_ ? Stats::now() - start_ : 0; }
+
+    // Leave ns of a stage timed inside this one out of it, so the two are
+    // not counted twice
+    void exclude(uint64_t ns) { excluded_ += ns; }
+
+    StageTimer(const StageTimer &) = delete;
+    StageTimer &operator=(const StageTimer &) = delete;
+
+private:
+    Stats::Stage stage_;
+    uint64_t bytes_;
+    uint64_t start_;
+    uint64_t excluded_ = 0;
+};
+
+#endif // STATS_H
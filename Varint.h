@@ -0,0 +1,72 @@
+/*
+ * Varint.h
+ *
+ * LEB128 variable-length integers used by the container headers: 7 bits
+ * per byte, least significant group first, high bit set on every byte but
+ * the last. A 64-bit value takes at most 10 bytes.
+ */
+
+#ifndef VARINT_H
+#define VARINT_H
+
+#include <cstddef>
+#include <cstdint>
+
+class Varint
+{
+public:
+    static const size_t kMaxBytes = 10;
+
+    enum Status
+    {
+        kOk,
+        kShort, // the value continues past the available bytes
+        kBad    // more than 64 bits
+    };
+
+    static size_t size(uint64_t v)
+    {
+        size_t n = 1;
+        while (v >= 0x80)
+        {
+            v >>= 7;
+            n++;
+        }
+        return n;
+    }
+
+    // Write v at out and return one past the last byte written
+    static char *store(char *out, uint64_t v)
+    {
+        while (v >= 0x80)
+        {
+            *out++ = static_cast<char>((v & 0x7F) | 0x80);
+            v >>= 7;
+        }
+        *out++ = static_cast<char>(v);
+        return out;
+    }
+
+    // Read a value at base[pos..end); pos advances only on kOk
+    static Status load(const char *base, size_t &pos, size_t end, uint64_t &v)
+    {
+        v = 0;
+        for (size_t i = 0; i < kMaxBytes; ++i)
+        {
+            if (pos + i >= end)
+                return kShort;
+            uint64_t b = static_cast<unsigned char>(base[pos + i]);
+            if (i == kMaxBytes - 1 && b > 1)
+                return kBad;
+            v |= (b & 0x7F) << (7 * i);
+            if (!(b & 0x80))
+            {
+                pos += i + 1;
+                return kOk;
+            }
+        }
+        return kBad;
+    }
+};
+
+#endif // VARINT_H
@@ -1,169 +1,92 @@
 #include "Vigenere.h"
+#include "KeyStream.h"
 #include <stdexcept>
-#include <unordered_map>
 
-// Diccionario para mapear letras a sus posiciones en el alfabeto
-static const std::unordered_map<char, int> letterToPosition = {
-    // Letras minúsculas (0-25)
-    {'a', 0},
-    {'b', 1},
-    {'c', 2},
-    {'d', 3},
-    {'e', 4},
-    {'f', 5},
-    {'g', 6},
-    {'h', 7},
-    {'i', 8},
-    {'j', 9},
-    {'k', 10},
-    {'l', 11},
-    {'m', 12},
-    {'n', 13},
-    {'o', 14},
-    {'p', 15},
-    {'q', 16},
-    {'r', 17},
-    {'s', 18},
-    {'t', 19},
-    {'u', 20},
-    {'v', 21},
-    {'w', 22},
-    {'x', 23},
-    {'y', 24},
-    {'z', 25},
-    // Letras mayúsculas (26-51)
-    {'A', 26},
-    {'B', 27},
-    {'C', 28},
-    {'D', 29},
-    {'E', 30},
-    {'F', 31},
-    {'G', 32},
-    {'H', 33},
-    {'I', 34},
-    {'J', 35},
-    {'K', 36},
-    {'L', 37},
-    {'M', 38},
-    {'N', 39},
-    {'O', 40},
-    {'P', 41},
-    {'Q', 42},
-    {'R', 43},
-    {'S', 44},
-    {'T', 45},
-    {'U', 46},
-    {'V', 47},
-    {'W', 48},
-    {'X', 49},
-    {'Y', 50},
-    {'Z', 51}};
-
-// Diccionario inverso: de posición a letra
-static const std::unordered_map<int, char> positionToLetter = {
-    // Letras minúsculas (0-25)
-    {0, 'a'}, {1, 'b'}, {2, 'c'}, {3, 'd'}, {4, 'e'}, {5, 'f'}, {6, 'g'}, {7, 'h'},
-    {8, 'i'}, {9, 'j'}, {10, 'k'}, {11, 'l'}, {12, 'm'}, {13, 'n'}, {14, 'o'}, {15, 'p'},
-    {16, 'q'}, {17, 'r'}, {18, 's'}, {19, 't'}, {20, 'u'}, {21, 'v'}, {22, 'w'}, {23, 'x'},
-    {24, 'y'}, {25, 'z'},
-    // Letras mayúsculas (26-51)
-    {26, 'A'}, {27, 'B'}, {28, 'C'}, {29, 'D'}, {30, 'E'}, {31, 'F'}, {32, 'G'}, {33, 'H'},
-    {34, 'I'}, {35, 'J'}, {36, 'K'}, {37, 'L'}, {38, 'M'}, {39, 'N'}, {40, 'O'}, {41, 'P'},
-    {42, 'Q'}, {43, 'R'}, {44, 'S'}, {45, 'T'}, {46, 'U'}, {47, 'V'}, {48, 'W'}, {49, 'X'},
-    {50, 'Y'}, {51, 'Z'}
-};
-
-// Cifra el contenido usando el cifrado Vigenere
-std::vector<char> Vigenere::VigenereEncryption(const std::vector<char> &data, const std::string &key)
+namespace
 {
-    const std::string normalizedKey = normalizeKey(key, data.size());
-    std::string encryptedMessage;
-
-    if (normalizedKey.empty())
+    void throwNotLetter()
     {
-        throw std::runtime_error("La clave no puede estar vacía");
-    }
-
-    if (data.empty())
-    {
-        return std::vector<char>();
+        throw std::out_of_range("Vigenere: el texto y la clave solo pueden contener letras A-Z/a-z");
     }
+}
 
-    for (int i = 0; i < data.size(); i++)
-    {
-        int value = letterToPosition.at(data[i]) + letterToPosition.at(normalizedKey[i]);
+// Cifra el contenido usando el cifrado Vigenere
+std::vector<char> Vigenere::VigenereEncryption(const std::vector<char> &data, const std::string &key, Mode mode)
+{
+    std::vector<char> out(data.size());
+    transform(data.data(), out.data(), data.size(), key, 0, mode, false);
+    return out;
+}
 
-        if (value > 51)
-        {
-            value = value % 52;  // Debe ser % 52 para tener 0-51
-        }
-        encryptedMessage += positionToLetter.at(value);
-    }
+// Descifra el contenido usando el cifrado Vigenere
+std::vector<char> Vigenere::VigenereDecryption(const std::vector<char> &data, const std::string &key, Mode mode)
+{
+    std::vector<char> out(data.size());
+    transform(data.data(), out.data(), data.size(), key, 0, mode, true);
+    return out;
+}
 
-    return std::vector<char>(encryptedMessage.begin(), encryptedMessage.end());
+void Vigenere::encryptBlock(const char *in, char *out, size_t size, const std::string &key, size_t offset,
+                            Mode mode)
+{
+    transform(in, out, size, key, offset, mode, false);
 }
 
-// Descifra el contenido usando el cifrado Vigenere
-std::vector<char> Vigenere::VigenereDecryption(const std::vector<char> &data, const std::string &key)
+void Vigenere::decryptBlock(const char *in, char *out, size_t size, const std::string &key, size_t offset,
+                            Mode mode)
 {
-    const std::string normalizedKey = normalizeKey(key, data.size());
-    std::string encryptedMessage;
+    transform(in, out, size, key, offset, mode, true);
+}
 
-    if (normalizedKey.empty())
+// Ambos modos van a KeyStream, que elige SSE2/AVX2 o la versión escalar
+void Vigenere::transform(const char *in, char *out, size_t size, const std::string &key, size_t offset,
+                         Mode mode, bool decrypt)
+{
+    if (key.empty())
     {
         throw std::runtime_error("La clave no puede estar vacía");
     }
-
-    if (data.empty())
-    {
-        return std::vector<char>();
-    }
-
-    for (int i = 0; i < data.size(); i++)
+    if (mode == Mode::Bytes)
     {
-        int value = letterToPosition.at(data[i]) - letterToPosition.at(normalizedKey[i]);
-
-        if (value < 0)
-        {
-            value = value + 52;  // Ajustar para valores negativos
-        }
-        encryptedMessage += positionToLetter.at(value);
+        KeyStream::addBytes(in, out, size, key, offset, decrypt);
+        return;
     }
-
-    return std::vector<char>(encryptedMessage.begin(), encryptedMessage.end());
+    std::vector<unsigned char> shifts = keyShifts(key);
+    if (!KeyStream::shiftLetters(in, out, size, shifts.data(), shifts.size(), offset, decrypt))
+        throwNotLetter();
 }
 
-// Normaliza la clave para que tenga el mismo tamaño que los datos
-std::string Vigenere::normalizeKey(const std::string &key, size_t dataLength)
+// Posición de cada letra de la clave: se recorre cíclicamente en lugar de
+// repetirla hasta el largo de los datos
+std::vector<unsigned char> Vigenere::keyShifts(const std::string &key)
 {
-    std::string normalizedKey;
-    normalizedKey.reserve(dataLength);
-
-    // Repetir la clave cíclicamente hasta alcanzar dataLength
-    for (size_t i = 0; i < dataLength; i++)
+    if (key.empty())
     {
-        normalizedKey += key[i % key.size()];
+        throw std::runtime_error("La clave no puede estar vacía");
     }
 
-    return normalizedKey;
+    std::vector<unsigned char> shifts(key.size());
+    for (size_t i = 0; i < key.size(); ++i)
+    {
+        char c = key[i];
+        if (c >= 'a' && c <= 'z')
+            shifts[i] = static_cast<unsigned char>(c - 'a');
+        else if (c >= 'A' && c <= 'Z')
+            shifts[i] = static_cast<unsigned char>(c - 'A' + 26);
+        else
+            throwNotLetter();
+    }
+    return shifts;
 }
 
-// Cifra un solo carácter
+// Cifra un solo byte: C = (P + K) mod 256
 char Vigenere::encryptChar(char plainChar, char keyChar)
 {
-    // TODO: Implementar cifrado de un carácter
-    // Formula: C = (P + K) mod 256 (para bytes completos)
-    // o usar el alfabeto A-Z tradicional
-
-    return plainChar;
+    return static_cast<char>(static_cast<unsigned char>(plainChar) + static_cast<unsigned char>(keyChar));
 }
 
-// Descifra un solo carácter
+// Descifra un solo byte: P = (C - K) mod 256
 char Vigenere::decryptChar(char cipherChar, char keyChar)
 {
-    // TODO: Implementar descifrado de un carácter
-    // Formula: P = (C - K) mod 256 (para bytes completos)
-    // o usar el alfabeto A-Z tradicional
-
-    return cipherChar;
+    return static_cast<char>(static_cast<unsigned char>(cipherChar) - static_cast<unsigned char>(keyChar));
 }
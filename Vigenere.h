@@ -7,21 +7,43 @@
 class Vigenere
 {
 public:
+    // Letters: alfabeto de 52 letras (a-z, A-Z); texto y clave solo pueden
+    // tener letras. Bytes: cualquier byte, C = (P + K) mod 256, sirve para
+    // binarios (PDF, salida comprimida)
+    enum class Mode
+    {
+        Letters,
+        Bytes
+    };
+
     // Cifra el contenido usando el cifrado Vigenere
-    static std::vector<char> VigenereEncryption(const std::vector<char> &data, const std::string &key);
+    static std::vector<char> VigenereEncryption(const std::vector<char> &data, const std::string &key,
+                                                Mode mode = Mode::Letters);
 
     // Descifra el contenido usando el cifrado Vigenere
-    static std::vector<char> VigenereDecryption(const std::vector<char> &data, const std::string &key);
+    static std::vector<char> VigenereDecryption(const std::vector<char> &data, const std::string &key,
+                                                Mode mode = Mode::Letters);
 
-private:
-    // Normaliza la clave para que tenga el mismo tamaño que los datos
-    static std::string normalizeKey(const std::string &key, size_t dataLength);
+    // Igual que las anteriores sobre in[0..size) -> out, empezando en la
+    // posición offset de la clave; permite cifrar por trozos. in == out vale.
+    static void encryptBlock(const char *in, char *out, size_t size, const std::string &key, size_t offset,
+                             Mode mode);
+    static void decryptBlock(const char *in, char *out, size_t size, const std::string &key, size_t offset,
+                             Mode mode);
 
-    // Cifra un solo carácter
+    // Cifra un solo byte (modo Bytes)
     static char encryptChar(char plainChar, char keyChar);
 
-    // Descifra un solo carácter
+    // Descifra un solo byte (modo Bytes)
     static char decryptChar(char cipherChar, char keyChar);
+
+private:
+    // Desplazamiento (0-51) de cada letra de la clave; lanza si está vacía
+    // o tiene caracteres que no son letras
+    static std::vector<unsigned char> keyShifts(const std::string &key);
+
+    static void transform(const char *in, char *out, size_t size, const std::string &key, size_t offset,
+                          Mode mode, bool decrypt);
 };
 
 #endif // VIGENERE_H
@@ -0,0 +1,369 @@
+// bench.cpp
+// End-to-end benchmark. Runs clitool's own pipeline (parse_args, prepare_run,
+// process_file and the ThreadPool) over reproducible corpora and prints one
+// JSON document with MB/s, p50/p99 per-file latency, peak RSS and output
+// ratio for every corpus, operation and worker count.
+// Build: g++ -std=c++17 -O2 -pthread bench.cpp cli_pipeline.cpp Huffman.cpp HuffmanTable.cpp Histogram.cpp Frame.cpp Lz77.cpp Fse.cpp Vigenere.cpp KeyStream.cpp -o bench
+// Run:   ./bench [--comp-alg huffman] [--workers 1,2,4] [--files 32] [--file-size 256K] [--reps 3] [--out bench.json]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "cli_pipeline.h"
+
+namespace
+{
+    const char *const kPdfSample = "ejemplo_prueba_grande.pdf";
+    const double kEntropyLevels[] = {1.0, 3.0, 5.0, 7.0, 8.0};
+
+    struct BenchOptions
+    {
+        std::string comp_alg = "huffman";
+        std::vector<unsigned> workers = {1, 2, 4};
+        size_t files = 32;
+        size_t file_size = size_t(256) << 10;
+        int reps = 3;
+        std::string out; // empty = stdout
+    };
+
+    struct Corpus
+    {
+        std::string name;
+        double entropy; // bits per byte, < 0 when not synthetic
+        fs::path dir;
+        uint64_t bytes;
+    };
+
+    // One timed run of an operation over a corpus
+    struct Run
+    {
+        double seconds = 0;
+        std::vector<double> latencies; // seconds per file
+        uint64_t in_bytes = 0;
+        uint64_t out_bytes = 0;
+        long peak_rss_kb = 0;
+        size_t errors = 0;
+    };
+
+    // Bytes drawn from p(i) ~ r^i over 256 values, with r chosen so the
+    // distribution has the requested entropy (8 = uniform)
+    std::vector<double> distributionWithEntropy(double bits)
+    {
+        auto make = [](double r)
+        {
+            std::vector<double> p(256);
+            double sum = 0, w = 1;
+            for (auto &v : p)
+            {
+                v = w;
+                sum += w;
+                w *= r;
+            }
+            for (auto &v : p)
+                v /= sum;
+            return p;
+        };
+        auto entropy = [](const std::vector<double> &p)
+        {
+            double h = 0;
+            for (double v : p)
+                h -= v > 0 ? v * std::log2(v) : 0;
+            return h;
+        };
+        double lo = 0, hi = 1;
+        for (int i = 0; i < 60; ++i)
+        {
+            double mid = (lo + hi) / 2;
+            (entropy(make(mid)) < bits ? lo : hi) = mid;
+        }
+        return make(hi);
+    }
+
+    void writeSynthetic(const fs::path &dir, double bits, const BenchOptions &bo, uint64_t seed)
+    {
+        std::vector<double> p = distributionWithEntropy(bits);
+        std::vector<double> cdf(256);
+        double acc = 0;
+        for (int i = 0; i < 256; ++i)
+            cdf[i] = acc += p[i];
+        cdf[255] = 1.0;
+
+        std::mt19937_64 rng(seed);
+        std::uniform_real_distribution<double> u(0, 1);
+        std::vector<char> buf(bo.file_size);
+        fs::create_directories(dir);
+        for (size_t f = 0; f < bo.files; ++f)
+        {
+            for (auto &c : buf)
+                c = static_cast<char>(std::lower_bound(cdf.begin(), cdf.end(), u(rng)) - cdf.begin());
+            write_all(dir / ("f" + std::to_string(f) + ".bin"), buf);
+        }
+    }
+
+    // Peak RSS is a high-water mark; clear_refs resets it between runs
+    void resetPeakRss()
+    {
+        std::ofstream("/proc/self/clear_refs") << "5";
+    }
+
+    long peakRssKb()
+    {
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line))
+        {
+            if (line.rfind("VmHWM:", 0) == 0)
+                return std::stol(line.substr(6));
+        }
+        struct rusage ru;
+        getrusage(RUSAGE_SELF, &ru);
+        return ru.ru_maxrss;
+    }
+
+    uint64_t treeBytes(const fs::path &root)
+    {
+        uint64_t n = 0;
+        for (const auto &f : collect_files(root))
+            n += fs::file_size(f);
+        return n;
+    }
+
+    bool sameTree(const fs::path &a, const fs::path &b)
+    {
+        for (const auto &f : collect_files(a))
+        {
+            fs::path g = b / fs::relative(f, a);
+            if (!fs::exists(g) || read_all(f) != read_all(g))
+                return false;
+        }
+        return true;
+    }
+
+    // Run clitool with these arguments through the same functions its
+    // main() uses, timing every file
+    Run runCli(const std::vector<std::string> &args)
+    {
+        std::vector<std::string> storage = {"clitool"};
+        storage.insert(storage.end(), args.begin(), args.end());
+        std::vector<char *> argv;
+        for (auto &a : storage)
+            argv.push_back(a.data());
+
+        Options opt = parse_args(static_cast<int>(argv.size()), argv.data());
+        load_dict(opt);
+        std::vector<fs::path> files = prepare_run(opt);
+
+        Run run;
+        std::mutex m;
+        resetPeakRss();
+        auto t0 = std::chrono::steady_clock::now();
+        {
+            ThreadPool pool(opt.workers);
+            for (const auto &f : files)
+            {
+                pool.enqueue([&, f]
+                             {
+                    auto s = std::chrono::steady_clock::now();
+                    uint64_t in = fs::file_size(f), out = 0;
+                    bool ok = true;
+                    try {
+                        out = fs::file_size(process_file(f, opt));
+                    } catch (const std::exception &) {
+                        ok = false;
+                    }
+                    double lat = std::chrono::duration<double>(std::chrono::steady_clock::now() - s).count();
+                    std::lock_guard<std::mutex> lk(m);
+                    run.latencies.push_back(lat);
+                    run.in_bytes += in;
+                    run.out_bytes += out;
+                    run.errors += ok ? 0 : 1; });
+            }
+        }
+        run.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        run.peak_rss_kb = peakRssKb();
+        return run;
+    }
+
+    double percentile(std::vector<double> v, double q)
+    {
+        if (v.empty())
+            return 0;
+        std::sort(v.begin(), v.end());
+        size_t i = static_cast<size_t>(std::ceil(q * v.size()));
+        return v[std::min(v.size() - 1, i == 0 ? 0 : i - 1)];
+    }
+
+    std::string jsonNumber(double v)
+    {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.6g", v);
+        return buf;
+    }
+
+    std::vector<unsigned> parseList(const std::string &s)
+    {
+        std::vector<unsigned> v;
+        std::stringstream ss(s);
+        std::string item;
+        while (std::getline(ss, item, ','))
+            v.push_back(static_cast<unsigned>(std::max(1, std::stoi(item))));
+        return v;
+    }
+
+    BenchOptions parseBenchArgs(int argc, char **argv)
+    {
+        BenchOptions bo;
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string a = argv[i];
+            if (i + 1 >= argc)
+                throw std::runtime_error("missing value for " + a);
+            std::string v = argv[++i];
+            if (a == "--comp-alg")
+                bo.comp_alg = v;
+            else if (a == "--workers")
+                bo.workers = parseList(v);
+            else if (a == "--files")
+                bo.files = std::max<size_t>(1, std::stoull(v));
+            else if (a == "--file-size")
+                bo.file_size = std::max<size_t>(1, parse_size(v));
+            else if (a == "--reps")
+                bo.reps = std::max(1, std::stoi(v));
+            else if (a == "--out")
+                bo.out = v;
+            else
+                throw std::runtime_error("unknown argument " + a);
+        }
+        return bo;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    try
+    {
+        BenchOptions bo = parseBenchArgs(argc, argv);
+        if (!parse_comp_alg(bo.comp_alg))
+            throw std::runtime_error("unsupported --comp-alg " + bo.comp_alg);
+
+        fs::path root = fs::temp_directory_path() / ("hv_bench_" + std::to_string(getpid()));
+        fs::remove_all(root);
+
+        // Corpora: fixed seeds, so every run sees the same bytes
+        std::vector<Corpus> corpora;
+        uint64_t seed = 1;
+        for (double bits : kEntropyLevels)
+        {
+            char name[32];
+            std::snprintf(name, sizeof(name), "entropy-%.1f", bits);
+            Corpus c{name, bits, root / "corpus" / name, 0};
+            writeSynthetic(c.dir, bits, bo, seed++);
+            corpora.push_back(c);
+        }
+        if (fs::exists(kPdfSample))
+        {
+            // the PDF is small, so it is repeated to give a latency distribution
+            Corpus c{"pdf", -1, root / "corpus" / "pdf", 0};
+            fs::create_directories(c.dir);
+            auto pdf = read_all(kPdfSample);
+            for (size_t f = 0; f < bo.files; ++f)
+                write_all(c.dir / ("f" + std::to_string(f) + ".pdf"), pdf);
+            corpora.push_back(c);
+        }
+        else
+        {
+            std::cerr << "note: " << kPdfSample << " not found, pdf corpus skipped\n";
+        }
+        for (auto &c : corpora)
+            c.bytes = treeBytes(c.dir);
+
+        std::ostringstream json;
+        json << "{\n  \"comp_alg\": \"" << bo.comp_alg << "\",\n  \"enc_alg\": \"xor\",\n"
+             << "  \"files_per_corpus\": " << bo.files << ",\n  \"reps\": " << bo.reps << ",\n"
+             << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n"
+             << "  \"results\": [";
+        bool first = true;
+
+        for (const auto &c : corpora)
+        {
+            for (unsigned w : bo.workers)
+            {
+                fs::path out = root / "out" / c.name / std::to_string(w);
+                const std::string ws = std::to_string(w);
+                const std::string cmp = (out / "c").string(), dec = (out / "d").string();
+                const std::string enc = (out / "e").string(), plain = (out / "u").string();
+                struct
+                {
+                    const char *op;
+                    std::vector<std::string> args;
+                    const std::string *result;
+                } ops[] = {
+                    {"compress", {"-c", "--comp-alg", bo.comp_alg, "-i", c.dir.string(), "-o", cmp, "--workers", ws}, &dec},
+                    {"decompress", {"-d", "--comp-alg", bo.comp_alg, "-i", cmp, "-o", dec, "--workers", ws}, &dec},
+                    {"encrypt", {"-e", "--enc-alg", "xor", "-k", "bench-key", "-i", c.dir.string(), "-o", enc, "--workers", ws}, &plain},
+                    {"decrypt", {"-u", "--enc-alg", "xor", "-k", "bench-key", "-i", enc, "-o", plain, "--workers", ws}, &plain},
+                };
+
+                for (const auto &o : ops)
+                {
+                    std::vector<double> seconds, latencies;
+                    Run last;
+                    long peak = 0;
+                    for (int r = 0; r < bo.reps; ++r)
+                    {
+                        last = runCli(o.args);
+                        seconds.push_back(last.seconds);
+                        latencies.insert(latencies.end(), last.latencies.begin(), last.latencies.end());
+                        peak = std::max(peak, last.peak_rss_kb);
+                    }
+                    double median = percentile(seconds, 0.5);
+                    bool inverse = std::string(o.op) == "decompress" || std::string(o.op) == "decrypt";
+                    // throughput is always counted on the uncompressed/plain side
+                    uint64_t raw = inverse ? last.out_bytes : last.in_bytes;
+
+                    json << (first ? "\n" : ",\n") << "    {\"corpus\": \"" << c.name << "\", ";
+                    if (c.entropy >= 0)
+                        json << "\"entropy_bits\": " << jsonNumber(c.entropy) << ", ";
+                    json << "\"files\": " << last.latencies.size() << ", \"bytes\": " << last.in_bytes
+                         << ", \"op\": \"" << o.op << "\", \"workers\": " << w
+                         << ", \"seconds\": " << jsonNumber(median)
+                         << ", \"mb_per_s\": " << jsonNumber(median > 0 ? raw / median / 1e6 : 0)
+                         << ", \"p50_ms\": " << jsonNumber(percentile(latencies, 0.5) * 1e3)
+                         << ", \"p99_ms\": " << jsonNumber(percentile(latencies, 0.99) * 1e3)
+                         << ", \"peak_rss_kb\": " << peak
+                         << ", \"ratio\": " << jsonNumber(last.in_bytes ? double(last.out_bytes) / last.in_bytes : 0)
+                         << ", \"errors\": " << last.errors;
+                    if (inverse)
+                        json << ", \"roundtrip_ok\": " << (sameTree(c.dir, *o.result) ? "true" : "false");
+                    json << "}";
+                    first = false;
+                }
+            }
+        }
+        json << "\n  ]\n}\n";
+        fs::remove_all(root);
+
+        if (bo.out.empty())
+        {
+            std::cout << json.str();
+        }
+        else
+        {
+            std::string s = json.str();
+            write_all(bo.out, std::vector<char>(s.begin(), s.end()));
+        }
+    }
+    catch (const std::exception &ex)
+    {
+        std::cerr << "bench: " << ex.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
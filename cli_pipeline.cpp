@@ -0,0 +1,852 @@
+// cli_pipeline.cpp
+// Implementación de cli_pipeline.h: argumentos, etapas de (des)compresión y
+// cifrado, en memoria y por trozos, y el procesamiento de cada archivo.
+
+#include "cli_pipeline.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+// ====== Tu API de compresión ======
+// La daremos por existente según tu requerimiento:
+// Use the Huffman implementation in Huffman.cpp
+#include "Huffman.h"
+#include "Lz77.h"
+#include "Fse.h"
+#include "Histogram.h"
+#include "KeyStream.h"
+#include "Vigenere.h"
+#include "Stats.h"
+
+// Opcional: si tienes descompresión
+static std::vector<char> HuffmanDecompress(const std::vector<char> &data, unsigned threads,
+                                           const HuffmanDictionary *dict)
+{
+    // Use the real Huffman decompression from Huffman.cpp
+    return Huffman::HuffmanDecompression(data, threads, dict);
+}
+
+// ====== Utilidades de E/S binaria ======
+std::vector<char> read_all(const fs::path &p)
+{
+    std::ifstream ifs(p, std::ios::binary);
+    if (!ifs)
+        throw std::runtime_error("No se puede abrir: " + p.string());
+    ifs.seekg(0, std::ios::end);
+    std::streamsize sz = ifs.tellg();
+    ifs.seekg(0, std::ios::beg);
+    std::vector<char> buf(static_cast<size_t>(sz));
+    if (sz > 0 && !ifs.read(buf.data(), sz))
+    {
+        throw std::runtime_error("Error leyendo: " + p.string());
+    }
+    return buf;
+}
+
+void write_all(const fs::path &p, const std::vector<char> &data)
+{
+    if (!p.parent_path().empty())
+        fs::create_directories(p.parent_path());
+    std::ofstream ofs(p, std::ios::binary | std::ios::trunc);
+    if (!ofs)
+        throw std::runtime_error("No se puede crear: " + p.string());
+    if (!data.empty())
+        ofs.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+void print_help(const char *argv0)
+{
+    std::cout <<
+        R"(Uso:
+  )" << argv0 << R"( [operaciones] [opciones] -i <entrada> -o <salida>
+  )" << argv0 << R"( train [--max-code-len N] -i <corpus> -o <diccionario>
+
+Operaciones (pueden combinarse y el orden importa):
+  -c    Comprimir
+  -d    Descomprimir
+  -e    Encriptar
+  -u    Desencriptar
+  Ej: -ce  (comprimir luego encriptar)
+      -du  (desencriptar luego descomprimir)
+  -ce y -ud se hacen en una sola pasada por bloques; sin --block-size -ce usa
+  bloques de 256K, así que su salida difiere de -c seguido de -e (ambas se
+  descomprimen igual)
+
+Opciones:
+  --comp-alg <nombre>    Algoritmo de compresión: huffman, lz77 (LZ77 + Huffman),
+                         fse (ANS por tablas; mejor ratio en texto sesgado)
+  --enc-alg  <nombre>    Algoritmo de encriptación: xor, vigenere (por bytes,
+                         mod 256, sirve para cualquier archivo) o
+                         vigenere-letters (solo letras A-Z/a-z, como main.cpp)
+  -i <ruta>              Archivo o directorio de entrada
+  -o <ruta>              Archivo o directorio de salida
+  -k <clave>             Clave (requerida para -e/-u)
+  --workers <N>          Número de hilos (por defecto: #CPUs)
+  --max-code-len <N>     Longitud máxima de código Huffman, 8-15 (por defecto: 12)
+  --block-size <N[K|M]>  Divide cada archivo en bloques independientes (ej: 1M)
+                         que se comprimen/descomprimen en paralelo
+  --streams <N>          Sub-flujos entrelazados por bloque, 1-8 (por defecto: 1);
+                         4 acelera la descompresión en un solo hilo
+  --lz-depth <N>         Candidatos por posición en lz77, 1-4096 (por defecto: 16);
+                         más profundidad = salida más pequeña pero más lenta
+  --stream               Procesa cada archivo por trozos sin cargarlo entero
+                         en memoria (bloques de --block-size, por defecto 1M)
+  --dict <archivo>       Diccionario de 'train' (solo huffman): los archivos se
+                         codifican con su tabla y la cabecera solo guarda su ID;
+                         hace falta el mismo diccionario para descomprimir
+  --stats[=text|json]    Al terminar, imprime en stderr tiempo y bytes por etapa
+                         (lectura, compresión, cifrado, escritura e internos de
+                         Huffman) y el tiempo ocupado/inactivo de cada hilo
+  -h, --help             Ayuda
+
+Ejemplos:
+  )" << argv0 << R"( -ce --comp-alg huffman --enc-alg xor -i ./in -o ./out -k secreto
+  )" << argv0 << R"( -d --comp-alg huffman -i file.huff -o file.raw
+  )" << argv0 << R"( train -i ./muestras -o textos.dict
+  )" << argv0 << R"( -c --comp-alg huffman --dict textos.dict -i ./in -o ./out
+)";
+}
+
+std::optional<CompAlg> parse_comp_alg(const std::string &s)
+{
+    if (s == "huffman")
+        return CompAlg::Huffman;
+    if (s == "lz77")
+        return CompAlg::Lz77;
+    if (s == "fse")
+        return CompAlg::Fse;
+    return std::nullopt;
+}
+std::optional<EncAlg> parse_enc_alg(const std::string &s)
+{
+    if (s == "xor")
+        return EncAlg::XOR;
+    if (s == "vigenere")
+        return EncAlg::Vigenere;
+    if (s == "vigenere-letters")
+        return EncAlg::VigenereLetters;
+    return std::nullopt;
+}
+
+// Tamaño con sufijo opcional K/M/G (potencias de 1024)
+size_t parse_size(const std::string &s)
+{
+    size_t used = 0;
+    unsigned long long n = std::stoull(s, &used);
+    std::string suffix = s.substr(used);
+    if (suffix == "K" || suffix == "k")
+        n <<= 10;
+    else if (suffix == "M" || suffix == "m")
+        n <<= 20;
+    else if (suffix == "G" || suffix == "g")
+        n <<= 30;
+    else if (!suffix.empty())
+        throw std::runtime_error("Tamaño inválido: " + s);
+    return static_cast<size_t>(n);
+}
+
+Options parse_args(int argc, char **argv)
+{
+    Options opt;
+    if (argc == 1)
+    {
+        print_help(argv[0]);
+        std::exit(0);
+    }
+
+    auto need_value = [&](int i)
+    {
+        if (i + 1 >= argc)
+            throw std::runtime_error(std::string("Falta valor para ") + argv[i]);
+    };
+
+    int first = 1;
+    if (std::string(argv[1]) == "train")
+    {
+        opt.train = true;
+        first = 2;
+    }
+
+    for (int i = first; i < argc; ++i)
+    {
+        std::string a = argv[i];
+
+        if (a == "-h" || a == "--help")
+        {
+            print_help(argv[0]);
+            std::exit(0);
+        }
+
+        if (a.size() > 1 && a[0] == '-' && a[1] != '-')
+        {
+            // flags cortas combinadas, ej: -ce
+            for (size_t j = 1; j < a.size(); ++j)
+            {
+                char f = a[j];
+                switch (f)
+                {
+                case 'c':
+                    opt.ops_in_order.push_back({OpKind::Compress});
+                    break;
+                case 'd':
+                    opt.ops_in_order.push_back({OpKind::Decompress});
+                    break;
+                case 'e':
+                    opt.ops_in_order.push_back({OpKind::Encrypt});
+                    break;
+                case 'u':
+                    opt.ops_in_order.push_back({OpKind::Decrypt});
+                    break;
+                case 'i':
+                    need_value(i);
+                    opt.input = argv[++i];
+                    j = a.size();
+                    break;
+                case 'o':
+                    need_value(i);
+                    opt.output = argv[++i];
+                    j = a.size();
+                    break;
+                case 'k':
+                    need_value(i);
+                    opt.key = argv[++i];
+                    j = a.size();
+                    break;
+                default:
+                    throw std::runtime_error(std::string("Flag desconocida -") + f);
+                }
+            }
+            continue;
+        }
+
+        if (a.rfind("--comp-alg", 0) == 0)
+        {
+            std::string v;
+            if (a == "--comp-alg")
+            {
+                need_value(i);
+                v = argv[++i];
+            }
+            else if (a.rfind("--comp-alg=", 0) == 0)
+                v = a.substr(11);
+            else
+                throw std::runtime_error("Sintaxis --comp-alg inválida");
+            opt.comp_alg = parse_comp_alg(v);
+            if (!opt.comp_alg)
+                throw std::runtime_error("Algoritmo de compresión no soportado: " + v);
+            continue;
+        }
+        if (a.rfind("--enc-alg", 0) == 0)
+        {
+            std::string v;
+            if (a == "--enc-alg")
+            {
+                need_value(i);
+                v = argv[++i];
+            }
+            else if (a.rfind("--enc-alg=", 0) == 0)
+                v = a.substr(10);
+            else
+                throw std::runtime_error("Sintaxis --enc-alg inválida");
+            opt.enc_alg = parse_enc_alg(v);
+            if (!opt.enc_alg)
+                throw std::runtime_error("Algoritmo de encriptación no soportado: " + v);
+            continue;
+        }
+        if (a == "--workers")
+        {
+            need_value(i);
+            opt.workers = std::max(1, std::stoi(argv[++i]));
+            continue;
+        }
+        if (a == "--max-code-len")
+        {
+            need_value(i);
+            int n = std::stoi(argv[++i]);
+            if (n < static_cast<int>(HuffmanCanonical::kMinMaxCodeLength) ||
+                n > static_cast<int>(HuffmanCanonical::kMaxMaxCodeLength))
+                throw std::runtime_error("--max-code-len debe estar entre 8 y 15");
+            opt.max_code_len = static_cast<unsigned>(n);
+            continue;
+        }
+        if (a == "--block-size")
+        {
+            need_value(i);
+            opt.block_size = parse_size(argv[++i]);
+            if (opt.block_size == 0)
+                throw std::runtime_error("--block-size debe ser mayor que 0");
+            continue;
+        }
+        if (a == "--streams")
+        {
+            need_value(i);
+            int n = std::stoi(argv[++i]);
+            if (n < 1 || n > static_cast<int>(HuffmanDecodeTable::kMaxStreams))
+                throw std::runtime_error("--streams debe estar entre 1 y 8");
+            opt.streams = static_cast<unsigned>(n);
+            continue;
+        }
+        if (a == "--lz-depth")
+        {
+            need_value(i);
+            int n = std::stoi(argv[++i]);
+            if (n < 1 || n > static_cast<int>(Lz77::kMaxDepth))
+                throw std::runtime_error("--lz-depth debe estar entre 1 y 4096");
+            opt.lz_depth = static_cast<unsigned>(n);
+            continue;
+        }
+        if (a == "--stream")
+        {
+            opt.stream = true;
+            continue;
+        }
+        if (a == "--dict")
+        {
+            need_value(i);
+            opt.dict_path = argv[++i];
+            continue;
+        }
+        if (a == "--stats" || a == "--stats=text")
+        {
+            opt.stats = StatsFormat::Text;
+            continue;
+        }
+        if (a == "--stats=json")
+        {
+            opt.stats = StatsFormat::Json;
+            continue;
+        }
+
+        // Posicional inesperado
+        throw std::runtime_error("Argumento desconocido: " + a);
+    }
+
+    // Validaciones mínimas
+    if (opt.train)
+    {
+        if (!opt.ops_in_order.empty())
+            throw std::runtime_error("train no admite operaciones (-c, -d, -e, -u).");
+        if (opt.input.empty() || opt.output.empty())
+            throw std::runtime_error("train necesita -i <corpus> y -o <diccionario>.");
+        return opt;
+    }
+    if (opt.ops_in_order.empty())
+        throw std::runtime_error("Debes especificar al menos una operación (-c, -d, -e, -u).");
+    if (opt.input.empty())
+        throw std::runtime_error("Falta -i <entrada>.");
+    if (opt.output.empty())
+        throw std::runtime_error("Falta -o <salida>.");
+    // Si hay e/u debe haber clave
+    bool needs_key = std::any_of(opt.ops_in_order.begin(), opt.ops_in_order.end(),
+                                 [](const Op &op)
+                                 { return op.kind == OpKind::Encrypt || op.kind == OpKind::Decrypt; });
+    if (needs_key && !opt.key)
+        throw std::runtime_error("Debes pasar -k <clave> para encriptar/desencriptar.");
+    // Si hay c/d debe haber comp-alg
+    bool needs_comp = std::any_of(opt.ops_in_order.begin(), opt.ops_in_order.end(),
+                                  [](const Op &op)
+                                  { return op.kind == OpKind::Compress || op.kind == OpKind::Decompress; });
+    if (needs_comp && !opt.comp_alg)
+        throw std::runtime_error("Debes indicar --comp-alg <algoritmo>.");
+    if (!opt.dict_path.empty() && (!needs_comp || *opt.comp_alg != CompAlg::Huffman))
+        throw std::runtime_error("--dict solo se usa al comprimir/descomprimir con --comp-alg huffman.");
+
+    return opt;
+}
+
+// ====== Pipeline de archivo ======
+
+std::vector<char> apply_compress(const std::vector<char> &in, CompAlg alg, const Options &opt)
+{
+    switch (alg)
+    {
+    case CompAlg::Huffman:
+    {
+        // Call the Huffman compressor implementation and return its buffer.
+        return Huffman::HuffmanCompression(in, opt.max_code_len, opt.block_size, opt.block_threads, opt.streams,
+                                           opt.dict.get());
+    }
+    case CompAlg::Lz77:
+        return Lz77::compress(in, opt.lz_depth, opt.block_size);
+    case CompAlg::Fse:
+        return Fse::compress(in, opt.block_size);
+    }
+    return in;
+}
+
+std::vector<char> apply_decompress(const std::vector<char> &in, CompAlg alg, const Options &opt)
+{
+    switch (alg)
+    {
+    case CompAlg::Huffman:
+    {
+        auto out = HuffmanDecompress(in, opt.block_threads, opt.dict.get());
+        // vacío es válido solo si el contenedor no tiene payload
+        if (out.empty() && Huffman::containerOverheadSize(in) != in.size())
+            throw std::runtime_error(opt.dict ? "Contenedor Huffman inválido o de otro diccionario"
+                                              : "Contenedor Huffman inválido (¿falta --dict?)");
+        return out;
+    }
+    case CompAlg::Lz77:
+    {
+        std::vector<char> out;
+        if (!Lz77::decompress(in, out))
+            throw std::runtime_error("Contenedor LZ77 inválido");
+        return out;
+    }
+    case CompAlg::Fse:
+    {
+        std::vector<char> out;
+        if (!Fse::decompress(in, out))
+            throw std::runtime_error("Contenedor FSE inválido");
+        return out;
+    }
+    }
+    return in;
+}
+
+// Cifra/descifra in[0..n) en out desde la posición offset de la clave.
+// in == out vale: todos los algoritmos trabajan byte a byte.
+void apply_cipher(const char *in, char *out, size_t n, EncAlg alg, const std::string &key, size_t offset,
+                  bool decrypt)
+{
+    if (key.empty())
+        throw std::runtime_error("Clave vacía");
+    switch (alg)
+    {
+    case EncAlg::XOR:
+        KeyStream::xorBytes(in, out, n, key, offset); // XOR simétrica
+        break;
+    case EncAlg::Vigenere:
+    case EncAlg::VigenereLetters:
+    {
+        auto mode = alg == EncAlg::Vigenere ? Vigenere::Mode::Bytes : Vigenere::Mode::Letters;
+        if (decrypt)
+            Vigenere::decryptBlock(in, out, n, key, offset, mode);
+        else
+            Vigenere::encryptBlock(in, out, n, key, offset, mode);
+        break;
+    }
+    }
+}
+
+// ====== Pipeline por trozos (memoria acotada) ======
+
+// Una etapa recibe bytes con write() y entrega su salida a la siguiente;
+// finish() vacía lo que tenga pendiente.
+struct StreamStage
+{
+    ByteSink write;
+    std::function<void()> finish;
+};
+
+// Etapa que alimenta un compresor por bloques (Huffman, LZ77 o FSE)
+template <typename Encoder>
+static StreamStage encoder_stage(std::shared_ptr<Encoder> enc)
+{
+    return {[enc](const char *p, size_t n)
+            { enc->write(p, n); },
+            [enc]
+            { enc->finish(); }};
+}
+
+// Etapa que alimenta un descompresor; name aparece en los errores
+template <typename Decoder>
+static StreamStage decoder_stage(std::shared_ptr<Decoder> dec, const std::string &name)
+{
+    return {[dec, name](const char *p, size_t n)
+            {
+                if (!dec->write(p, n))
+                    throw std::runtime_error("Contenedor " + name + " inválido");
+            },
+            [dec, name]
+            {
+                if (!dec->finish())
+                    throw std::runtime_error("Contenedor " + name + " incompleto");
+            }};
+}
+
+static StreamStage make_stream_stage(const Op &op, const Options &opt, ByteSink next)
+{
+    switch (op.kind)
+    {
+    case OpKind::Compress:
+        switch (*opt.comp_alg)
+        {
+        case CompAlg::Lz77:
+            return encoder_stage(std::make_shared<Lz77Encoder>(next, opt.lz_depth, opt.block_size));
+        case CompAlg::Fse:
+            return encoder_stage(std::make_shared<FseEncoder>(next, opt.block_size));
+        case CompAlg::Huffman:
+            break;
+        }
+        return encoder_stage(std::make_shared<HuffmanEncoder>(next, opt.max_code_len, opt.block_size,
+                                                              opt.streams, opt.dict.get()));
+    case OpKind::Decompress:
+        switch (*opt.comp_alg)
+        {
+        case CompAlg::Lz77:
+            return decoder_stage(std::make_shared<Lz77Decoder>(next), "LZ77");
+        case CompAlg::Fse:
+            return decoder_stage(std::make_shared<FseDecoder>(next), "FSE");
+        case CompAlg::Huffman:
+            break;
+        }
+        return decoder_stage(std::make_shared<HuffmanDecoder>(next, opt.dict.get()), "Huffman");
+    case OpKind::Encrypt:
+    case OpKind::Decrypt:
+    {
+        // Cifrado de clave repetida: la posición en la clave sigue corriendo
+        // entre trozos
+        const std::string key = *opt.key;
+        if (key.empty())
+            throw std::runtime_error("Clave vacía");
+        const bool decrypt = op.kind == OpKind::Decrypt;
+        const EncAlg alg = *opt.enc_alg;
+        auto offset = std::make_shared<size_t>(0);
+        auto scratch = std::make_shared<std::vector<char>>();
+        const Stats::Stage stage = decrypt ? Stats::Stage::Decrypt : Stats::Stage::Encrypt;
+        return {[=](const char *p, size_t n)
+                {
+                    {
+                        // solo el cifrado; la etapa siguiente se mide aparte
+                        StageTimer timer(stage, n);
+                        scratch->resize(n);
+                        apply_cipher(p, scratch->data(), n, alg, key, *offset, decrypt);
+                        *offset = (*offset + n) % key.size();
+                    }
+                    next(scratch->data(), n);
+                },
+                [] {}};
+    }
+    }
+    return {next, [] {}};
+}
+
+static void run_pipeline_stream(const fs::path &in_path, const fs::path &out_path,
+                                const std::vector<Op> &ops, const Options &opt)
+{
+    std::ifstream ifs(in_path, std::ios::binary);
+    if (!ifs)
+        throw std::runtime_error("No se puede abrir: " + in_path.string());
+    if (!out_path.parent_path().empty())
+        fs::create_directories(out_path.parent_path());
+    std::ofstream ofs(out_path, std::ios::binary | std::ios::trunc);
+    if (!ofs)
+        throw std::runtime_error("No se puede crear: " + out_path.string());
+
+    // Se arma de atrás hacia adelante: cada etapa escribe en la siguiente
+    std::vector<StreamStage> stages(ops.size());
+    ByteSink next = [&ofs](const char *p, size_t n)
+    {
+        StageTimer timer(Stats::Stage::Write, n);
+        ofs.write(p, static_cast<std::streamsize>(n));
+    };
+    for (size_t i = ops.size(); i-- > 0;)
+    {
+        stages[i] = make_stream_stage(ops[i], opt, next);
+        next = stages[i].write;
+    }
+
+    std::vector<char> chunk(size_t(64) << 10);
+    while (ifs)
+    {
+        size_t n;
+        {
+            StageTimer timer(Stats::Stage::Read, 0);
+            ifs.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+            n = static_cast<size_t>(ifs.gcount());
+            timer.setBytes(n);
+        }
+        if (n > 0)
+            next(chunk.data(), n);
+    }
+    if (ifs.bad())
+        throw std::runtime_error("Error leyendo: " + in_path.string());
+    for (auto &st : stages)
+        st.finish();
+    if (!ofs)
+        throw std::runtime_error("Error escribiendo: " + out_path.string());
+}
+
+// ====== Etapas fusionadas (-ce / -ud) ======
+
+// Comprime y cifra en una sola pasada: cada bloque se codifica directamente
+// en el buffer de salida y se cifra ahí mismo mientras sigue en caché, así
+// que la salida comprimida se escribe una vez y se relee una sola vez desde
+// la caché en lugar de desde la memoria. Sin --block-size los bloques son
+// de kFusedBlockSize (entrada y salida del bloque caben en la L2), así que
+// la salida solo coincide con -c seguido de -e cuando se da --block-size.
+// En --stats el tiempo del cifrado va a encrypt y no a compress.
+std::vector<char> compress_encrypt(const std::vector<char> &in, const Options &opt)
+{
+    StageTimer compress(Stats::Stage::Compress, in.size());
+    const size_t block = opt.block_size ? opt.block_size : kFusedBlockSize;
+    const std::string &key = *opt.key;
+    RangeFn cipher = [&](char *p, size_t n, size_t pos)
+    {
+        StageTimer timer(Stats::Stage::Encrypt, n);
+        apply_cipher(p, p, n, *opt.enc_alg, key, pos, false);
+        compress.exclude(timer.elapsed());
+    };
+    switch (*opt.comp_alg)
+    {
+    case CompAlg::Huffman:
+        return Huffman::HuffmanCompression(in, opt.max_code_len, block, 1, opt.streams, opt.dict.get(), cipher);
+    case CompAlg::Lz77:
+        return Lz77::compress(in, opt.lz_depth, block, cipher);
+    case CompAlg::Fse:
+        return Fse::compress(in, block, cipher);
+    }
+    return in;
+}
+
+// Descifra y descomprime en una sola pasada: cada bloque se descifra en su
+// sitio justo antes de decodificarlo directamente en la salida, sin copias
+// intermedias. in queda descifrado solo en parte. Como en compress_encrypt,
+// decompress no incluye el tiempo de decrypt.
+std::vector<char> decrypt_decompress(std::vector<char> &in, const Options &opt)
+{
+    StageTimer decompress(Stats::Stage::Decompress, in.size());
+    const std::string &key = *opt.key;
+    RangeFn decipher = [&](char *p, size_t n, size_t pos)
+    {
+        StageTimer timer(Stats::Stage::Decrypt, n);
+        apply_cipher(p, p, n, *opt.enc_alg, key, pos, true);
+        decompress.exclude(timer.elapsed());
+    };
+    std::vector<char> out;
+    switch (*opt.comp_alg)
+    {
+    case CompAlg::Huffman:
+        if (!Huffman::HuffmanDecompression(in, decipher, out, opt.dict.get()))
+            throw std::runtime_error(opt.dict ? "Contenedor Huffman inválido o de otro diccionario"
+                                              : "Contenedor Huffman inválido (¿falta --dict?)");
+        break;
+    case CompAlg::Lz77:
+        if (!Lz77::decompress(in, decipher, out))
+            throw std::runtime_error("Contenedor LZ77 inválido");
+        break;
+    case CompAlg::Fse:
+        if (!Fse::decompress(in, decipher, out))
+            throw std::runtime_error("Contenedor FSE inválido");
+        break;
+    }
+    return out;
+}
+
+// Los datos entran por valor (el llamador los mueve) y cada etapa los
+// reemplaza por movimiento: el cifrado trabaja en el mismo buffer y la
+// (des)compresión libera la entrada en cuanto tiene su salida, así que por
+// archivo solo conviven un buffer de entrada y uno de salida.
+// -c seguido de -e (y -u seguido de -d) se hacen en una pasada con las
+// etapas fusionadas, salvo cuando los bloques del archivo se reparten entre
+// varios hilos: ahí gana la (des)compresión en paralelo.
+std::vector<char> run_pipeline(std::vector<char> cur,
+                               const std::vector<Op> &ops,
+                               const Options &opt)
+{
+    const bool fuse = opt.block_threads <= 1;
+    for (size_t i = 0; i < ops.size(); ++i)
+    {
+        const Op &op = ops[i];
+        const OpKind next = i + 1 < ops.size() ? ops[i + 1].kind : op.kind;
+        // las etapas fusionadas registran sus propios tiempos
+        if (fuse && op.kind == OpKind::Compress && next == OpKind::Encrypt)
+        {
+            cur = compress_encrypt(cur, opt);
+            ++i;
+            continue;
+        }
+        if (fuse && op.kind == OpKind::Decrypt && next == OpKind::Decompress)
+        {
+            cur = decrypt_decompress(cur, opt);
+            ++i;
+            continue;
+        }
+        switch (op.kind)
+        {
+        case OpKind::Compress:
+        {
+            StageTimer timer(Stats::Stage::Compress, cur.size());
+            cur = apply_compress(cur, *opt.comp_alg, opt);
+            break;
+        }
+        case OpKind::Decompress:
+        {
+            StageTimer timer(Stats::Stage::Decompress, cur.size());
+            cur = apply_decompress(cur, *opt.comp_alg, opt);
+            break;
+        }
+        case OpKind::Encrypt:
+        {
+            StageTimer timer(Stats::Stage::Encrypt, cur.size());
+            apply_cipher(cur.data(), cur.data(), cur.size(), *opt.enc_alg, *opt.key, 0, false);
+            break;
+        }
+        case OpKind::Decrypt:
+        {
+            StageTimer timer(Stats::Stage::Decrypt, cur.size());
+            apply_cipher(cur.data(), cur.data(), cur.size(), *opt.enc_alg, *opt.key, 0, true);
+            break;
+        }
+        }
+    }
+    return cur;
+}
+
+// Calcula ruta de salida preservando estructura cuando input es directorio
+static fs::path map_output_path(const fs::path &input_root, const fs::path &input_file, const fs::path &out_root)
+{
+    if (fs::is_regular_file(input_root))
+    {
+        // Usuario dio archivo: si salida es directorio, conservar nombre; si es archivo, usarlo tal cual
+        if (fs::is_directory(out_root))
+            return out_root / input_root.filename();
+        return out_root;
+    }
+    else
+    {
+        // Usuario dio directorio: replicar estructura relativa
+        auto rel = fs::relative(input_file, input_root);
+        return out_root / rel;
+    }
+}
+
+// ====== Lote de archivos ======
+// Archivos regulares de la entrada (un archivo o un directorio recursivo)
+std::vector<fs::path> collect_files(const fs::path &input)
+{
+    std::vector<fs::path> files;
+    if (fs::is_regular_file(input))
+    {
+        files.push_back(input);
+    }
+    else if (fs::is_directory(input))
+    {
+        for (auto &entry : fs::recursive_directory_iterator(input))
+        {
+            if (entry.is_regular_file())
+                files.push_back(entry.path());
+        }
+    }
+    else
+    {
+        throw std::runtime_error("La entrada no existe o no es archivo/directorio válido.");
+    }
+    return files;
+}
+
+// Comando train: histograma conjunto del corpus -> diccionario Huffman
+void run_train(const Options &opt)
+{
+    std::vector<fs::path> files = collect_files(opt.input);
+    uint64_t total[256] = {};
+    uint64_t bytes = 0;
+    for (const auto &f : files)
+    {
+        auto data = read_all(f);
+        uint64_t freq[256];
+        Histogram::count(reinterpret_cast<const unsigned char *>(data.data()), data.size(), freq);
+        for (int s = 0; s < 256; ++s)
+            total[s] += freq[s];
+        bytes += data.size();
+    }
+    HuffmanDictionary dict;
+    if (!HuffmanDictionary::train(total, dict, opt.max_code_len))
+        throw std::runtime_error("El corpus de entrenamiento está vacío.");
+    write_all(opt.output, dict.serialize());
+    std::cout << "Diccionario " << std::hex << std::setw(8) << std::setfill('0') << dict.id() << std::dec
+              << " entrenado con " << files.size() << " archivo(s), " << bytes << " bytes -> "
+              << opt.output << "\n";
+}
+
+// Carga --dict, si se pasó
+void load_dict(Options &opt)
+{
+    if (opt.dict_path.empty())
+        return;
+    auto dict = std::make_shared<HuffmanDictionary>();
+    if (!HuffmanDictionary::parse(read_all(opt.dict_path), *dict))
+        throw std::runtime_error("Diccionario inválido: " + opt.dict_path.string());
+    opt.dict = dict;
+}
+
+// Lista los archivos, prepara la salida y reparte los hilos; devuelve los
+// archivos a procesar
+std::vector<fs::path> prepare_run(Options &opt)
+{
+    // Construir lista de archivos a procesar
+    std::vector<fs::path> files = collect_files(opt.input);
+    if (files.empty())
+        return files;
+
+    // Preparar salida
+    if (fs::exists(opt.output) && fs::is_regular_file(opt.output) && files.size() > 1)
+    {
+        throw std::runtime_error("Salida apunta a archivo pero hay múltiples entradas.");
+    }
+    if (!fs::exists(opt.output))
+    {
+        // Si salida pretende ser directorio para múltiples entradas, créalo
+        if (files.size() > 1 || fs::is_directory(opt.input))
+        {
+            fs::create_directories(opt.output);
+        }
+    }
+
+    // Hilos sobrantes del pool se reparten entre los bloques de cada archivo
+    opt.block_threads = std::max<unsigned>(1, opt.workers / static_cast<unsigned>(
+                                                                std::min<size_t>(files.size(), opt.workers)));
+    return files;
+}
+
+// Aplica las operaciones a un archivo; devuelve la ruta de salida
+fs::path process_file(const fs::path &f, const Options &opt)
+{
+    fs::path out_path = map_output_path(opt.input, f, opt.output);
+
+    // Opcional: extensions según operaciones (solo ejemplo)
+    // -c => añade ".cmp", -e => ".enc"; -d/-u => quita si corresponde
+    for (const auto &op : opt.ops_in_order)
+    {
+        if (op.kind == OpKind::Compress)
+            out_path += ".cmp";
+        if (op.kind == OpKind::Encrypt)
+            out_path += ".enc";
+        if (op.kind == OpKind::Decompress && out_path.extension() == ".cmp")
+            out_path.replace_extension();
+        if (op.kind == OpKind::Decrypt && out_path.extension() == ".enc")
+            out_path.replace_extension();
+    }
+
+    if (opt.stream)
+    {
+        run_pipeline_stream(f, out_path, opt.ops_in_order, opt);
+    }
+    else
+    {
+        std::vector<char> in_data;
+        {
+            StageTimer timer(Stats::Stage::Read, 0);
+            in_data = read_all(f);
+            timer.setBytes(in_data.size());
+        }
+        auto out_data = run_pipeline(std::move(in_data), opt.ops_in_order, opt);
+        StageTimer timer(Stats::Stage::Write, out_data.size());
+        write_all(out_path, out_data);
+    }
+
+    if (Stats::enabled())
+    {
+        Stats::Counters &c = Stats::local();
+        c.files++;
+        c.inBytes += fs::file_size(f);
+        c.outBytes += fs::file_size(out_path);
+    }
+    return out_path;
+}
@@ -0,0 +1,196 @@
+// cli_pipeline.h
+// Opciones, pool de hilos y pipeline por archivo de clitool. Lo enlazan
+// clitool (cli_layout.cpp), bench y microbench, así miden exactamente el
+// mismo código que corre la herramienta.
+
+#ifndef CLI_PIPELINE_H
+#define CLI_PIPELINE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Huffman.h"
+#include "Lz77.h"
+#include "Stats.h"
+
+namespace fs = std::filesystem;
+
+// ====== Operaciones encadenables ======
+enum class OpKind
+{
+    Compress,
+    Decompress,
+    Encrypt,
+    Decrypt
+};
+
+struct Op
+{
+    OpKind kind;
+};
+
+enum class CompAlg
+{
+    Huffman,
+    Lz77, /* LZ77 + Huffman por flujo */
+    Fse   /* tANS: codificación entrópica con bits fraccionarios */
+};
+enum class StatsFormat
+{
+    Off,
+    Text,
+    Json
+};
+enum class EncAlg
+{
+    XOR,
+    Vigenere,       /* byte a byte, mod 256: cualquier archivo */
+    VigenereLetters /* alfabeto de 52 letras: solo texto A-Z/a-z */
+    /*, AES, ChaCha20, etc.*/
+};
+
+struct Options
+{
+    std::vector<Op> ops_in_order; // orden según flags (-ce => [C, E])
+    std::optional<CompAlg> comp_alg;
+    std::optional<EncAlg> enc_alg;
+    fs::path input;
+    fs::path output;
+    std::optional<std::string> key;
+    unsigned workers = std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : 4;
+    unsigned max_code_len = HuffmanCanonical::kDefaultMaxCodeLength;
+    size_t block_size = 0;     // 0 = un solo bloque por archivo
+    unsigned streams = 1;       // sub-flujos entrelazados por bloque
+    unsigned lz_depth = Lz77::kDefaultDepth; // candidatos por posición (lz77)
+    unsigned block_threads = 1; // hilos por archivo para bloques (se calcula en main)
+    bool stream = false;        // procesar por trozos con memoria acotada
+    bool train = false;         // comando train: entrenar un diccionario
+    fs::path dict_path;         // --dict
+    std::shared_ptr<const HuffmanDictionary> dict; // cargado en main
+    StatsFormat stats = StatsFormat::Off;           // --stats
+};
+
+// ====== Utilidades de E/S binaria ======
+std::vector<char> read_all(const fs::path &p);
+void write_all(const fs::path &p, const std::vector<char> &data);
+
+// ====== Argumentos ======
+
+// Imprime la ayuda de la línea de comandos
+void print_help(const char *argv0);
+
+// Nombre de algoritmo -> enum; nullopt si no se reconoce
+std::optional<CompAlg> parse_comp_alg(const std::string &s);
+std::optional<EncAlg> parse_enc_alg(const std::string &s);
+
+// Tamaño con sufijo opcional K/M/G (potencias de 1024)
+size_t parse_size(const std::string &s);
+
+// Interpreta argv; lanza std::runtime_error si algo no cuadra
+Options parse_args(int argc, char **argv);
+
+// ====== Thread Pool simple ======
+class ThreadPool
+{
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> tasks_;
+    std::mutex m_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+
+public:
+    explicit ThreadPool(unsigned n)
+    {
+        for (unsigned i = 0; i < n; ++i)
+        {
+            workers_.emplace_back([this, i]
+                                  {
+                // Con --stats cada hilo anota cuánto vivió y cuánto trabajó
+                const bool stats = Stats::enabled();
+                const uint64_t born = stats ? Stats::now() : 0;
+                if (stats) Stats::local().worker = i + 1;
+                for (;;) {
+                    std::function<void()> job;
+                    {
+                        std::unique_lock<std::mutex> lk(m_);
+                        cv_.wait(lk, [this]{ return stop_ || !tasks_.empty(); });
+                        if (stop_ && tasks_.empty()) {
+                            if (stats) Stats::local().aliveNs = Stats::now() - born;
+                            return;
+                        }
+                        job = std::move(tasks_.front());
+                        tasks_.pop();
+                    }
+                    const uint64_t start = stats ? Stats::now() : 0;
+                    job();
+                    if (stats) Stats::local().busyNs += Stats::now() - start;
+                } });
+        }
+    }
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto &t : workers_)
+            t.join();
+    }
+    void enqueue(std::function<void()> job)
+    {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            tasks_.push(std::move(job));
+        }
+        cv_.notify_one();
+    }
+};
+
+// ====== Etapas ======
+
+std::vector<char> apply_compress(const std::vector<char> &in, CompAlg alg, const Options &opt);
+std::vector<char> apply_decompress(const std::vector<char> &in, CompAlg alg, const Options &opt);
+
+// Cifra/descifra in[0..n) en out desde la posición offset de la clave.
+// in == out vale.
+void apply_cipher(const char *in, char *out, size_t n, EncAlg alg, const std::string &key, size_t offset,
+                  bool decrypt);
+
+// -ce / -ud en una sola pasada; decrypt_decompress descifra in en su sitio.
+// Bloque de -ce sin --block-size: entrada y salida caben en la caché L2.
+const size_t kFusedBlockSize = size_t(256) << 10;
+std::vector<char> compress_encrypt(const std::vector<char> &in, const Options &opt);
+std::vector<char> decrypt_decompress(std::vector<char> &in, const Options &opt);
+
+// Aplica ops en orden a un archivo completo en memoria
+std::vector<char> run_pipeline(std::vector<char> cur, const std::vector<Op> &ops, const Options &opt);
+
+// ====== Lote de archivos ======
+
+// Archivos regulares de la entrada (un archivo o un directorio recursivo)
+std::vector<fs::path> collect_files(const fs::path &input);
+
+// Comando train: entrena un diccionario Huffman con el corpus de opt.input
+void run_train(const Options &opt);
+
+// Carga --dict, si se pasó
+void load_dict(Options &opt);
+
+// Lista los archivos, prepara la salida y reparte los hilos; devuelve los
+// archivos a procesar
+std::vector<fs::path> prepare_run(Options &opt);
+
+// Aplica las operaciones a un archivo; devuelve la ruta de salida
+fs::path process_file(const fs::path &f, const Options &opt);
+
+#endif // CLI_PIPELINE_H
@@ -2,15 +2,60 @@
 #include <filesystem>
 #include <vector>
 #include <string>
-#include <cstdio>     // std::rename
-#include <unistd.h>   // para fork, exec
-#include <sys/wait.h> // para wait
+#include <sstream>
+#include <stdexcept>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <algorithm>
 #include "Huffman.h"
 #include "Vigenere.h"
+#include "cli_pipeline.h"
 
 namespace fs = std::filesystem;
 using namespace std;
 
+// Los hilos arman el informe de cada archivo aparte y lo imprimen entero,
+// así las líneas de archivos distintos no se mezclan
+void printReport(const string &text)
+{
+    static mutex coutMutex;
+    lock_guard<mutex> lk(coutMutex);
+    cout << text << flush;
+}
+
+// Archivos de la ruta (el archivo mismo o el árbol completo) que cumplen
+// accept. Se listan antes de empezar para no recorrer las salidas que los
+// trabajadores van creando en el mismo árbol.
+vector<fs::path> collectFiles(const fs::path &input, const function<bool(const fs::path &)> &accept)
+{
+    vector<fs::path> files;
+    if (fs::is_regular_file(input))
+    {
+        if (accept(input))
+            files.push_back(input);
+    }
+    else if (fs::is_directory(input))
+    {
+        for (auto &entry : fs::recursive_directory_iterator(input))
+        {
+            if (entry.is_regular_file() && accept(entry.path()))
+                files.push_back(entry.path());
+        }
+    }
+    return files;
+}
+
+// Reparte los archivos entre workers hilos (el mismo ThreadPool de clitool)
+// y espera a que terminen: el destructor vacía la cola y une los hilos
+void processAll(const vector<fs::path> &files, unsigned workers, const function<void(const fs::path &)> &work)
+{
+    ThreadPool pool(static_cast<unsigned>(max<size_t>(1, min<size_t>(workers, files.size()))));
+    for (const auto &f : files)
+        pool.enqueue([&work, f]
+                     { work(f); });
+}
+
 // ============================================
 // FUNCIONES PARA COMPRESIÓN
 // ============================================
@@ -23,64 +68,56 @@ bool isCompressibleFile(const fs::path &p)
     return e == ".pdf" || e == ".txt";
 }
 
+// Cada archivo lleva su propia tabla dentro del .huf, así que no hay estado
+// compartido entre archivos y se pueden comprimir a la vez
 void processFile(const fs::path &file)
 {
-    cout << "\n[+] Procesando: " << file << endl;
+    ostringstream log;
+    log << "\n[+] Procesando: " << file << endl;
 
     // 1. Leer archivo como binario
     vector<char> data = Huffman::readUncompressedFile(file.string());
     if (data.empty())
     {
-        cout << "   (No se pudo leer)\n";
+        log << "   (No se pudo leer)\n";
+        printReport(log.str());
         return;
     }
 
     long originalSize = data.size();
 
-    // 2. Comprimir → esto genera freqTable.bin
+    // 2. Comprimir → contenedor autocontenido (cabecera con tabla + datos)
     vector<char> compressed = Huffman::HuffmanCompression(data);
+    data = vector<char>(); // el original ya no hace falta; se libera antes de escribir
 
     // 3. Guardar el comprimido
     fs::path outHuf = file.string() + ".huf";
-    Huffman::writeFile(outHuf.string(), compressed);
-    cout << "   Comprimido → " << outHuf << endl;
-
-    // 4. Renombrar freqTable.bin para guardarla con nombre único
-    fs::path freqSrc = "freqTable.bin";
-    fs::path freqDest = file.string() + ".freq";
-
-    long compressedSize = 0;
-    long freqSize = 0;
-
-    if (fs::exists(freqSrc))
+    if (!Huffman::writeFile(outHuf.string(), compressed))
     {
-        freqSize = fs::file_size(freqSrc);
-        fs::rename(freqSrc, freqDest);
-        // Ocultar archivo .freq (sin mostrar en salida)
-    }
-    else
-    {
-        cout << "   ADVERTENCIA: no se encontró freqTable.bin\n";
+        log << "   ERROR: No se pudo escribir " << outHuf << "\n";
+        printReport(log.str());
+        return;
     }
+    log << "   Comprimido → " << outHuf << endl;
 
-    if (fs::exists(outHuf))
-    {
-        compressedSize = fs::file_size(outHuf);
-    }
+    // 4. Las tablas van embebidas en el .huf (cabecera + marcos de bloque)
+    long freqSize = static_cast<long>(Huffman::containerOverheadSize(compressed));
+    long compressedSize = static_cast<long>(compressed.size()) - freqSize;
 
     // Mostrar estadísticas
     long totalCompressed = compressedSize + freqSize;
     double ratio = (originalSize > 0) ? (100.0 * compressedSize / originalSize) : 0;
     double ratioTotal = (originalSize > 0) ? (100.0 * totalCompressed / originalSize) : 0;
 
-    cout << "      Original:    " << originalSize << " bytes (" << (originalSize / 1024.0) << " KB)\n";
-    cout << "      Comprimido:  " << compressedSize << " bytes (" << (compressedSize / 1024.0) << " KB) - " << ratio << "%\n";
+    log << "      Original:    " << originalSize << " bytes (" << (originalSize / 1024.0) << " KB)\n";
+    log << "      Comprimido:  " << compressedSize << " bytes (" << (compressedSize / 1024.0) << " KB) - " << ratio << "%\n";
     if (freqSize > 0)
-        cout << "      +Tabla freq: " << freqSize << " bytes (" << (freqSize / 1024.0) << " KB)\n";
-    cout << "      Total:       " << totalCompressed << " bytes (" << (totalCompressed / 1024.0) << " KB) - " << ratioTotal << "%\n";
+        log << "      +Cabecera:   " << freqSize << " bytes (" << (freqSize / 1024.0) << " KB)\n";
+    log << "      Total:       " << totalCompressed << " bytes (" << (totalCompressed / 1024.0) << " KB) - " << ratioTotal << "%\n";
+    printReport(log.str());
 }
 
-void compressMode(const fs::path &input)
+void compressMode(const fs::path &input, unsigned workers)
 {
     cout << "\n=== MODO COMPRESIÓN ===\n";
 
@@ -90,19 +127,7 @@ void compressMode(const fs::path &input)
         return;
     }
 
-    if (fs::is_regular_file(input))
-    {
-        if (isCompressibleFile(input))
-            processFile(input);
-    }
-    else if (fs::is_directory(input))
-    {
-        for (auto &entry : fs::recursive_directory_iterator(input))
-        {
-            if (entry.is_regular_file() && isCompressibleFile(entry.path()))
-                processFile(entry.path());
-        }
-    }
+    processAll(collectFiles(input, isCompressibleFile), workers, processFile);
 
     cout << "\nCompresión finalizada.\n";
 }
@@ -113,40 +138,15 @@ void compressMode(const fs::path &input)
 
 void decompressFile(const fs::path &hufFile)
 {
-    cout << "\n[+] Descomprimiendo: " << hufFile << endl;
-
-    // Intentar encontrar archivo .freq
-    // Primero: hufFile + ".freq" (ejemplo.pdf.huf.freq)
-    // Segundo: archivo_original + ".freq" (ejemplo.pdf.freq)
-    fs::path freqFile = hufFile.string() + ".freq";
-
-    if (!fs::exists(freqFile))
-    {
-        // Intentar sin el .huf (por si fue comprimido como ejemplo.pdf y después pasó a .huf)
-        string hufStr = hufFile.string();
-        if (hufStr.size() > 4 && hufStr.substr(hufStr.size() - 4) == ".huf")
-        {
-            string baseName = hufStr.substr(0, hufStr.size() - 4); // Remove .huf
-            freqFile = baseName + ".freq";
-        }
-    }
-
-    // Validar que exista el archivo .freq
-    if (!fs::exists(freqFile))
-    {
-        cout << "   ERROR: No se encontró tabla de frecuencias.\n";
-        cout << "   Buscadas: " << hufFile.string() + ".freq" << endl;
-        return;
-    }
-
-    // Restaurar freqTable.bin (lo requiere la función)
-    fs::copy(freqFile, "freqTable.bin", fs::copy_options::overwrite_existing);
+    ostringstream log;
+    log << "\n[+] Descomprimiendo: " << hufFile << endl;
 
     // Leer comprimido
     auto compressed = Huffman::readUncompressedFile(hufFile.string());
     if (compressed.empty())
     {
-        cout << "   ERROR: No se pudo leer archivo comprimido\n";
+        log << "   ERROR: No se pudo leer archivo comprimido\n";
+        printReport(log.str());
         return;
     }
 
@@ -155,30 +155,26 @@ void decompressFile(const fs::path &hufFile)
 
     // Guardar resultado
     fs::path output = hufFile.string() + ".restored";
-    Huffman::writeFile(output.string(), restored);
-    cout << "   Descomprimido → " << output << endl;
+    if (!Huffman::writeFile(output.string(), restored))
+    {
+        log << "   ERROR: No se pudo escribir " << output << "\n";
+        printReport(log.str());
+        return;
+    }
+    log << "   Descomprimido → " << output << endl;
 
     // Mostrar estadísticas
-    long compressedTotal = 0;
-    if (fs::exists(hufFile))
-        compressedTotal += fs::file_size(hufFile);
-    if (fs::exists(freqFile))
-        compressedTotal += fs::file_size(freqFile);
+    long compressedTotal = static_cast<long>(compressed.size());
 
     long restoredSize = restored.size();
     double ratio = (compressedTotal > 0) ? (100.0 * restoredSize / compressedTotal) : 0;
 
-    cout << "      Restaurado:  " << restoredSize << " bytes (" << (restoredSize / 1024.0) << " KB)\n";
-    cout << "      Ratio:       " << ratio << "% (expansión)\n";
-
-    // Limpiar freqTable.bin temporal
-    if (fs::exists("freqTable.bin"))
-    {
-        fs::remove("freqTable.bin");
-    }
+    log << "      Restaurado:  " << restoredSize << " bytes (" << (restoredSize / 1024.0) << " KB)\n";
+    log << "      Ratio:       " << ratio << "% (expansión)\n";
+    printReport(log.str());
 }
 
-void decompressMode(const fs::path &input)
+void decompressMode(const fs::path &input, unsigned workers)
 {
     cout << "\n=== MODO DESCOMPRESIÓN ===\n";
 
@@ -188,95 +184,62 @@ void decompressMode(const fs::path &input)
         return;
     }
 
-    if (fs::is_regular_file(input))
-    {
-        if (input.extension() == ".huf")
-        {
-            decompressFile(input);
-        }
-        else
-        {
-            cout << "El archivo debe tener extensión .huf\n";
-        }
-    }
-    else if (fs::is_directory(input))
+    if (fs::is_regular_file(input) && input.extension() != ".huf")
     {
-        for (auto &entry : fs::recursive_directory_iterator(input))
-        {
-            if (entry.is_regular_file() && entry.path().extension() == ".huf")
-                decompressFile(entry.path());
-        }
+        cout << "El archivo debe tener extensión .huf\n";
+        return;
     }
 
+    auto files = collectFiles(input, [](const fs::path &p)
+                              { return p.extension() == ".huf"; });
+    processAll(files, workers, decompressFile);
+
     cout << "\nDescompresión finalizada.\n";
 }
 
 // ============================================
-// FUNCIONES PARA ENCRIPTACIÓN (CON SYSTEM CALLS)
+// FUNCIONES PARA ENCRIPTACIÓN (POOL DE HILOS)
 // ============================================
 
 void encryptFile(const fs::path &file, const string &key)
 {
-    cout << "\n[+] Encriptando: " << file << endl;
+    ostringstream log;
+    log << "\n[+] Encriptando: " << file << endl;
 
     // Leer archivo
     vector<char> data = Huffman::readUncompressedFile(file.string());
     if (data.empty())
     {
-        cout << "   ERROR: No se pudo leer el archivo\n";
+        log << "   ERROR: No se pudo leer el archivo\n";
+        printReport(log.str());
         return;
     }
 
-    // Crear proceso hijo usando fork
-    pid_t pid = fork();
-
-    if (pid < 0)
-    {
-        cout << "   ERROR: No se pudo crear proceso hijo\n";
-        return;
-    }
-    else if (pid == 0)
+    try
     {
-        // Proceso HIJO: realizar encriptación
-        vector<char> encrypted = Vigenere::VigenereEncryption(data, key);
+        // Cifrado en el mismo buffer; si el texto no es válido lanza y no se
+        // escribe nada
+        long originalSize = data.size();
+        Vigenere::encryptBlock(data.data(), data.data(), data.size(), key, 0, Vigenere::Mode::Letters);
 
-        // Guardar archivo encriptado
         fs::path outEnc = file.string() + ".enc";
-        Huffman::writeFile(outEnc.string(), encrypted);
+        if (!Huffman::writeFile(outEnc.string(), data))
+            throw runtime_error("no se pudo escribir " + outEnc.string());
+        log << "   Encriptado → " << outEnc << endl;
 
-        // Terminar proceso hijo
-        exit(0);
+        // Mostrar estadísticas
+        long encryptedSize = fs::file_size(outEnc);
+        log << "      Original:    " << originalSize << " bytes (" << (originalSize / 1024.0) << " KB)\n";
+        log << "      Encriptado:  " << encryptedSize << " bytes (" << (encryptedSize / 1024.0) << " KB)\n";
     }
-    else
+    catch (const exception &e)
     {
-        // Proceso PADRE: esperar a que termine el hijo
-        int status;
-        waitpid(pid, &status, 0);
-
-        if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
-        {
-            fs::path outEnc = file.string() + ".enc";
-            cout << "   Encriptado → " << outEnc << endl;
-
-            // Mostrar estadísticas
-            long originalSize = data.size();
-            long encryptedSize = 0;
-            if (fs::exists(outEnc))
-            {
-                encryptedSize = fs::file_size(outEnc);
-            }
-
-            cout << "      Original:    " << originalSize << " bytes (" << (originalSize / 1024.0) << " KB)\n";
-            cout << "      Encriptado:  " << encryptedSize << " bytes (" << (encryptedSize / 1024.0) << " KB)\n";
-        }
-        else
-        {
-            cout << "   ERROR: Fallo en la encriptación\n";
-        }
+        log << "   ERROR: Fallo en la encriptación: " << e.what() << "\n";
     }
+    printReport(log.str());
 }
 
-void encryptMode(const fs::path &input, const string &key)
+void encryptMode(const fs::path &input, const string &key, unsigned workers)
 {
     cout << "\n=== MODO ENCRIPTACIÓN ===\n";
 
@@ -292,88 +255,55 @@ void encryptMode(const fs::path &input, const string &key)
         return;
     }
 
-    if (fs::is_regular_file(input))
-    {
-        encryptFile(input, key);
-    }
-    else if (fs::is_directory(input))
-    {
-        for (auto &entry : fs::recursive_directory_iterator(input))
-        {
-            if (entry.is_regular_file())
-                encryptFile(entry.path(), key);
-        }
-    }
+    auto files = collectFiles(input, [](const fs::path &)
+                              { return true; });
+    processAll(files, workers, [&key](const fs::path &f)
+               { encryptFile(f, key); });
 
     cout << "\nEncriptación finalizada.\n";
 }
 
 // ============================================
-// FUNCIONES PARA DESENCRIPTACIÓN (CON SYSTEM CALLS)
+// FUNCIONES PARA DESENCRIPTACIÓN (POOL DE HILOS)
 // ============================================
 
 void decryptFile(const fs::path &file, const string &key)
 {
-    cout << "\n[+] Desencriptando: " << file << endl;
+    ostringstream log;
+    log << "\n[+] Desencriptando: " << file << endl;
 
     // Leer archivo encriptado
-    vector<char> encrypted = Huffman::readUncompressedFile(file.string());
-    if (encrypted.empty())
+    vector<char> data = Huffman::readUncompressedFile(file.string());
+    if (data.empty())
     {
-        cout << "   ERROR: No se pudo leer el archivo\n";
+        log << "   ERROR: No se pudo leer el archivo\n";
+        printReport(log.str());
         return;
     }
 
-    // Crear proceso hijo usando fork
-    pid_t pid = fork();
-
-    if (pid < 0)
-    {
-        cout << "   ERROR: No se pudo crear proceso hijo\n";
-        return;
-    }
-    else if (pid == 0)
+    try
     {
-        // Proceso HIJO: realizar desencriptación
-        vector<char> decrypted = Vigenere::VigenereDecryption(encrypted, key);
+        long encryptedSize = data.size();
+        Vigenere::decryptBlock(data.data(), data.data(), data.size(), key, 0, Vigenere::Mode::Letters);
 
-        // Guardar archivo desencriptado
         fs::path outDec = file.string() + ".dec";
-        Huffman::writeFile(outDec.string(), decrypted);
+        if (!Huffman::writeFile(outDec.string(), data))
+            throw runtime_error("no se pudo escribir " + outDec.string());
+        log << "   Desencriptado → " << outDec << endl;
 
-        // Terminar proceso hijo
-        exit(0);
+        // Mostrar estadísticas
+        long decryptedSize = fs::file_size(outDec);
+        log << "      Encriptado:    " << encryptedSize << " bytes (" << (encryptedSize / 1024.0) << " KB)\n";
+        log << "      Desencriptado: " << decryptedSize << " bytes (" << (decryptedSize / 1024.0) << " KB)\n";
     }
-    else
+    catch (const exception &e)
     {
-        // Proceso PADRE: esperar a que termine el hijo
-        int status;
-        waitpid(pid, &status, 0);
-
-        if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
-        {
-            fs::path outDec = file.string() + ".dec";
-            cout << "   Desencriptado → " << outDec << endl;
-
-            // Mostrar estadísticas
-            long encryptedSize = encrypted.size();
-            long decryptedSize = 0;
-            if (fs::exists(outDec))
-            {
-                decryptedSize = fs::file_size(outDec);
-            }
-
-            cout << "      Encriptado:    " << encryptedSize << " bytes (" << (encryptedSize / 1024.0) << " KB)\n";
-            cout << "      Desencriptado: " << decryptedSize << " bytes (" << (decryptedSize / 1024.0) << " KB)\n";
-        }
-        else
-        {
-            cout << "   ERROR: Fallo en la desencriptación\n";
-        }
+        log << "   ERROR: Fallo en la desencriptación: " << e.what() << "\n";
     }
+    printReport(log.str());
 }
 
-void decryptMode(const fs::path &input, const string &key)
+void decryptMode(const fs::path &input, const string &key, unsigned workers)
 {
     cout << "\n=== MODO DESENCRIPTACIÓN ===\n";
 
@@ -389,26 +319,17 @@ void decryptMode(const fs::path &input, const string &key)
         return;
     }
 
-    if (fs::is_regular_file(input))
+    if (fs::is_regular_file(input) && input.extension() != ".enc")
     {
-        if (input.extension() == ".enc")
-        {
-            decryptFile(input, key);
-        }
-        else
-        {
-            cout << "El archivo debe tener extensión .enc\n";
-        }
-    }
-    else if (fs::is_directory(input))
-    {
-        for (auto &entry : fs::recursive_directory_iterator(input))
-        {
-            if (entry.is_regular_file() && entry.path().extension() == ".enc")
-                decryptFile(entry.path(), key);
-        }
+        cout << "El archivo debe tener extensión .enc\n";
+        return;
     }
 
+    auto files = collectFiles(input, [](const fs::path &p)
+                              { return p.extension() == ".enc"; });
+    processAll(files, workers, [&key](const fs::path &f)
+               { decryptFile(f, key); });
+
     cout << "\nDesencriptación finalizada.\n";
 }
 
@@ -418,12 +339,15 @@ void decryptMode(const fs::path &input, const string &key)
 
 void showUsage(const char *program)
 {
-    cout << "Uso: " << program << " <modo> <ruta> [clave]\n\n";
+    cout << "Uso: " << program << " <modo> <ruta> [clave] [--workers N]\n\n";
     cout << "Modos:\n";
     cout << "  -c, --compress    Comprimir archivos (PDF, TXT)\n";
     cout << "  -d, --decompress  Descomprimir archivos .huf\n";
     cout << "  -e, --encrypt     Encriptar archivos (requiere clave)\n";
     cout << "  -z, --decrypt     Desencriptar archivos .enc (requiere clave)\n\n";
+    cout << "Opciones:\n";
+    cout << "  -j, --workers N   Archivos procesados a la vez\n";
+    cout << "                    (por defecto, uno por núcleo)\n\n";
     cout << "Ejemplos:\n";
     cout << "  " << program << " -c archivo.pdf\n";
     cout << "  " << program << " -c archivo.txt\n";
@@ -431,27 +355,50 @@ void showUsage(const char *program)
     cout << "  " << program << " -d archivo.pdf.huf\n";
     cout << "  " << program << " -e archivo.txt miClave123\n";
     cout << "  " << program << " -z archivo.txt.enc miClave123\n";
+    cout << "  " << program << " -e carpeta/ miClave123 --workers 4\n";
 }
 
 int main(int argc, char **argv)
 {
-    if (argc < 3)
+    // --workers N puede ir en cualquier posición; el resto son posicionales
+    unsigned workers = max(1u, thread::hardware_concurrency());
+    vector<string> args;
+    for (int i = 1; i < argc; ++i)
+    {
+        string a = argv[i];
+        if ((a == "-j" || a == "--workers") && i + 1 < argc)
+        {
+            int n = atoi(argv[++i]);
+            if (n < 1)
+            {
+                cout << "ERROR: --workers debe ser >= 1\n";
+                return 1;
+            }
+            workers = static_cast<unsigned>(n);
+        }
+        else
+        {
+            args.push_back(a);
+        }
+    }
+
+    if (args.size() < 2)
     {
         showUsage(argv[0]);
         return 0;
     }
 
-    string mode = argv[1];
-    fs::path input = argv[2];
-    string key = (argc >= 4) ? argv[3] : "";
+    string mode = args[0];
+    fs::path input = args[1];
+    string key = (args.size() >= 3) ? args[2] : "";
 
     if (mode == "-c" || mode == "--compress")
     {
-        compressMode(input);
+        compressMode(input, workers);
     }
     else if (mode == "-d" || mode == "--decompress")
     {
-        decompressMode(input);
+        decompressMode(input, workers);
     }
     else if (mode == "-e" || mode == "--encrypt")
     {
@@ -461,7 +408,7 @@ int main(int argc, char **argv)
             showUsage(argv[0]);
             return 1;
         }
-        encryptMode(input, key);
+        encryptMode(input, key, workers);
     }
     else if (mode == "-z" || mode == "--decrypt")
     {
@@ -471,7 +418,7 @@ int main(int argc, char **argv)
             showUsage(argv[0]);
             return 1;
         }
-        decryptMode(input, key);
+        decryptMode(input, key, workers);
     }
     else
     {
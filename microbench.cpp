@@ -0,0 +1,304 @@
+// microbench.cpp
+// Kernel microbenchmarks. Reports MB/s and cycles per byte for each kernel.
+// Cycles come from the TSC, so they are reference cycles at the nominal
+// clock rather than core cycles.
+// Build: g++ -std=c++17 -O2 -pthread microbench.cpp cli_pipeline.cpp Huffman.cpp HuffmanTable.cpp Histogram.cpp Frame.cpp Fse.cpp Lz77.cpp Vigenere.cpp KeyStream.cpp -o microbench
+// Run:   ./microbench [size_MiB]
+//        ./microbench sweep [max_MiB]   per-kernel sweep, 4 KiB up to max_MiB (default 256)
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "Fse.h"
+#include "Histogram.h"
+#include "Huffman.h"
+#include "HuffmanTable.h"
+#include "KeyStream.h"
+#include "Vigenere.h"
+// the CLI cipher and fused stages, the same code clitool runs
+#include "cli_pipeline.h"
+
+namespace
+{
+    uint64_t cycles()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return 0;
+#endif
+    }
+
+    // Run fn `reps` times after one warmup call and print the best result
+    void bench(const char *name, size_t bytes, int reps, const std::function<void()> &fn)
+    {
+        fn();
+        double best = 1e30;
+        uint64_t bestCycles = 0;
+        for (int r = 0; r < reps; ++r)
+        {
+            auto t0 = std::chrono::steady_clock::now();
+            uint64_t c0 = cycles();
+            fn();
+            uint64_t c1 = cycles();
+            double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            if (s < best)
+            {
+                best = s;
+                bestCycles = c1 - c0;
+            }
+        }
+        std::printf("%-28s %10zu B  %9.1f MB/s  %6.2f cycles/B\n", name, bytes,
+                    bytes / best / 1e6, bytes ? double(bestCycles) / bytes : 0.0);
+    }
+
+    // Frequency loop as it used to be in HuffmanCompression: linear search
+    // through the list of symbols seen so far
+    void countLinearSearch(const std::vector<char> &input, std::vector<std::pair<char, int>> &frequency)
+    {
+        frequency.clear();
+        for (char c : input)
+        {
+            bool found = false;
+            for (auto &pair : frequency)
+            {
+                if (pair.first == c)
+                {
+                    pair.second++;
+                    found = true;
+                    break;
+                }
+            }
+            if (!found)
+                frequency.push_back(std::make_pair(c, 1));
+        }
+    }
+
+    // Each kernel on its own, one buffer size at a time. Small buffers get
+    // more repetitions so every measurement covers at least kSweepBytes.
+    void kernelSweep(size_t maxSize)
+    {
+        const size_t kMinSize = size_t(4) << 10;
+        const size_t kSweepBytes = size_t(64) << 20;
+        const char kLetters[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+        const std::string key = "LlaveDePrueba";
+        const unsigned maxLen = HuffmanCanonical::kDefaultMaxCodeLength;
+
+        // letters only, so the Vigenere kernels accept it; skewed like text
+        std::vector<char> data(std::max(maxSize, kMinSize));
+        std::mt19937_64 rng(7);
+        std::geometric_distribution<int> geo(0.08);
+        for (auto &c : data)
+            c = kLetters[geo(rng) % 52];
+
+        std::vector<unsigned char> packed;
+        std::vector<char> decoded, buf;
+        uint64_t freq[256];
+        uint8_t lengths[256];
+        uint32_t codes[256];
+        HuffmanEncodeTable enc;
+        HuffmanDecodeTable dec;
+
+        for (size_t size = kMinSize; size <= maxSize; size *= 4)
+        {
+            const int reps = static_cast<int>(std::clamp<size_t>(kSweepBytes / size, 3, 1000));
+            const unsigned char *p = reinterpret_cast<const unsigned char *>(data.data());
+            buf.assign(data.begin(), data.begin() + size);
+
+            Histogram::count(p, size, freq);
+            HuffmanCanonical::buildCodeLengths(freq, maxLen, lengths);
+            HuffmanCanonical::assignCodes(lengths, codes);
+            enc.build(codes, lengths);
+            dec.build(codes, lengths);
+            const uint64_t bits = enc.encodedBits(freq);
+            packed.resize((bits + 7) / 8 + HuffmanEncodeTable::kOutputSlack);
+            decoded.resize(size);
+
+            std::printf("-- %zu KiB, %d reps\n", size >> 10, reps);
+            bench("histogram", size, reps, [&]
+                  { Histogram::count(p, size, freq); });
+            bench("tree + code lengths", size, reps, [&]
+                  {
+                      HuffmanCanonical::buildCodeLengths(freq, maxLen, lengths);
+                      HuffmanCanonical::assignCodes(lengths, codes); });
+            bench("huffman encode loop", size, reps, [&]
+                  { enc.encode(p, size, packed.data()); });
+            bench("huffman decode loop", size, reps, [&]
+                  { dec.decode(packed.data(), packed.size(), bits, decoded.data(), size); });
+            if (!std::equal(decoded.begin(), decoded.end(), data.begin()))
+                std::printf("   decode mismatch!\n");
+            bench("vigenere encrypt", size, reps, [&]
+                  { decoded = Vigenere::VigenereEncryption(buf, key); });
+            bench("vigenere decrypt", size, reps, [&]
+                  { Vigenere::VigenereDecryption(decoded, key); });
+            bench("xor (in place)", size, reps, [&]
+                  { apply_cipher(buf.data(), buf.data(), size, EncAlg::XOR, key, 0, false); });
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && std::string(argv[1]) == "sweep")
+    {
+        std::printf("== kernel sweep (xor/vigenere: %s)\n", KeyStream::isa());
+        kernelSweep((argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 256) << 20);
+        return 0;
+    }
+
+    size_t size = (argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 64) << 20;
+
+    // all 256 byte values present, like a binary PDF; plus a run-heavy
+    // buffer where a single counter would serialize
+    std::vector<char> random(size), runs(size);
+    std::mt19937_64 rng(42);
+    for (size_t i = 0; i < size; ++i)
+        random[i] = static_cast<char>(rng());
+    for (size_t i = 0; i < size; ++i)
+        runs[i] = static_cast<char>((i >> 12) & 0x3);
+
+    uint64_t freq[256];
+    std::vector<std::pair<char, int>> list;
+    const int reps = 5;
+
+    std::printf("== histogram\n");
+    for (auto *buf : {&random, &runs})
+    {
+        const char *label = buf == &random ? "random" : "runs";
+        const unsigned char *p = reinterpret_cast<const unsigned char *>(buf->data());
+        std::printf("-- %s\n", label);
+        bench("linear search (old)", size, 1, [&]
+              { countLinearSearch(*buf, list); });
+        bench("naive 256-bin", size, reps, [&]
+              { Histogram::countNaive(p, size, freq); });
+        bench("4x interleaved", size, reps, [&]
+              { Histogram::countSerial(p, size, freq); });
+        bench("4x interleaved, threads", size, reps, [&]
+              { Histogram::count(p, size, freq); });
+    }
+
+    // Block-parallel compression scaling: 1 MiB blocks, 1..N threads
+    std::vector<char> text(size);
+    std::geometric_distribution<int> geo(0.08);
+    for (auto &c : text)
+        c = static_cast<char>('a' + geo(rng) % 40);
+    const size_t blockSize = size_t(1) << 20;
+    unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::printf("== huffman blocks (1 MiB)\n");
+    std::vector<char> packed, unpacked;
+    for (unsigned t = 1;; t = std::min(t * 2, maxThreads))
+    {
+        std::string c = "compress   " + std::to_string(t) + " thr";
+        std::string d = "decompress " + std::to_string(t) + " thr";
+        bench(c.c_str(), size, reps, [&]
+              { packed = Huffman::HuffmanCompression(text, HuffmanCanonical::kDefaultMaxCodeLength, blockSize, t); });
+        bench(d.c_str(), size, reps, [&]
+              { Huffman::HuffmanDecompression(packed, t); });
+        if (t == maxThreads)
+            break;
+    }
+
+    // Interleaved sub-streams: single-threaded decode, whole buffer per block
+    std::printf("== huffman sub-streams (1 thread)\n");
+    for (unsigned n = 1; n <= HuffmanDecodeTable::kMaxStreams; n *= 2)
+    {
+        std::string d = "decompress " + std::to_string(n) + " stream" + (n > 1 ? "s" : "");
+        packed = Huffman::HuffmanCompression(text, HuffmanCanonical::kDefaultMaxCodeLength, 0, 1, n);
+        bench(d.c_str(), size, reps, [&]
+              { Huffman::HuffmanDecompression(packed, 1); });
+    }
+
+    // Small files: per-file table vs a dictionary trained on the same kind
+    // of text, 4 KiB at a time
+    const size_t small = 4096;
+    std::vector<char> piece(text.begin(), text.begin() + small);
+    Histogram::count(reinterpret_cast<const unsigned char *>(text.data()), size, freq);
+    HuffmanDictionary dict;
+    if (!HuffmanDictionary::train(freq, dict))
+    {
+        std::fprintf(stderr, "dictionary training failed\n");
+        return 1;
+    }
+    std::printf("== huffman small files (4 KiB)\n");
+    const HuffmanDictionary *trained = &dict;
+    for (const HuffmanDictionary *d : {static_cast<const HuffmanDictionary *>(nullptr), trained})
+    {
+        const char *label = d ? "dictionary" : "own table";
+        std::string c = std::string("compress   ") + label;
+        std::string u = std::string("decompress ") + label;
+        bench(c.c_str(), small, reps * 100, [&]
+              { packed = Huffman::HuffmanCompression(piece, HuffmanCanonical::kDefaultMaxCodeLength, 0, 1, 1, d); });
+        std::printf("%-28s %10zu B  ratio %.4f\n", label, packed.size(), double(packed.size()) / small);
+        bench(u.c_str(), small, reps * 100, [&]
+              { Huffman::HuffmanDecompression(packed, 1, d); });
+    }
+
+    // Entropy backends on the same inputs: the text above and a heavily
+    // skewed one where a whole-bit code wastes most on the top symbol
+    std::vector<char> skewed(size);
+    std::geometric_distribution<int> steep(0.6);
+    for (auto &c : skewed)
+        c = static_cast<char>('a' + steep(rng) % 40);
+
+    std::printf("== huffman vs fse (1 MiB blocks, 1 thread)\n");
+    for (auto *buf : {&text, &skewed})
+    {
+        std::printf("-- %s\n", buf == &text ? "text" : "skewed");
+        bench("huffman compress", size, reps, [&]
+              { packed = Huffman::HuffmanCompression(*buf, HuffmanCanonical::kDefaultMaxCodeLength, blockSize); });
+        std::printf("%-28s %10zu B  ratio %.4f\n", "huffman size", packed.size(), double(packed.size()) / size);
+        bench("huffman decompress", size, reps, [&]
+              { Huffman::HuffmanDecompression(packed, 1); });
+        packed = Huffman::HuffmanCompression(*buf, HuffmanCanonical::kDefaultMaxCodeLength, blockSize, 1, 4);
+        bench("huffman decompress 4 str", size, reps, [&]
+              { Huffman::HuffmanDecompression(packed, 1); });
+        bench("fse compress", size, reps, [&]
+              { packed = Fse::compress(*buf, blockSize); });
+        std::printf("%-28s %10zu B  ratio %.4f\n", "fse size", packed.size(), double(packed.size()) / size);
+        bench("fse decompress", size, reps, [&]
+              { Fse::decompress(packed, unpacked); });
+    }
+
+    // clitool -ce / -ud: the two stages back to back over whole buffers vs
+    // the fused stages, which cipher each block while it is still in cache
+    Options opt;
+    opt.comp_alg = CompAlg::Huffman;
+    opt.enc_alg = EncAlg::XOR;
+    opt.key = "LlaveDePrueba";
+    opt.block_size = kFusedBlockSize;
+    std::vector<char> sealed, plain(size);
+    std::printf("== compress+xor / xor+decompress (%zu KiB blocks, 1 thread)\n", kFusedBlockSize >> 10);
+    bench("-ce separate", size, reps, [&]
+          {
+              sealed = apply_compress(text, CompAlg::Huffman, opt);
+              apply_cipher(sealed.data(), sealed.data(), sealed.size(), EncAlg::XOR, *opt.key, 0, false); });
+    bench("-ce fused", size, reps, [&]
+          { sealed = compress_encrypt(text, opt); });
+    // both start from a fresh copy, as each deciphers it in place
+    bench("-ud separate", size, reps, [&]
+          {
+              packed = sealed;
+              apply_cipher(packed.data(), packed.data(), packed.size(), EncAlg::XOR, *opt.key, 0, true);
+              plain = apply_decompress(packed, CompAlg::Huffman, opt); });
+    bench("-ud fused", size, reps, [&]
+          {
+              packed = sealed;
+              plain = decrypt_decompress(packed, opt); });
+    if (plain != text)
+        std::printf("   round-trip mismatch!\n");
+    return 0;
+}
@@ -10,11 +10,14 @@ echo ""
 
 # Check if argument is provided
 if [ $# -eq 0 ]; then
-    echo "Usage: ./run.sh [cli|demo]"
+    echo "Usage: ./run.sh [cli|demo|microbench|bench|large]"
     echo ""
     echo "Options:"
-    echo "  cli   - Compile and run CLI tool with example operations"
-    echo "  demo  - Compile and run the demo program (main.cpp)"
+    echo "  cli        - Compile and run CLI tool with example operations"
+    echo "  demo       - Compile and run the demo program (main.cpp)"
+    echo "  microbench - Compile and run the kernel microbenchmarks ('microbench sweep' for 4 KiB-256 MiB)"
+    echo "  bench      - Compile and run the end-to-end benchmark (writes bench.json)"
+    echo "  large      - Round-trip a sparse file larger than 4 GiB (needs ~6 GB of disk)"
     exit 1
 fi
 
@@ -22,7 +25,7 @@ MODE=$1
 
 if [ "$MODE" == "cli" ]; then
     echo "Building CLI tool..."
-    g++ -std=c++17 -O2 -pthread cli_layout.cpp Huffman.cpp -o clitool
+    g++ -std=c++17 -O2 -pthread cli_layout.cpp cli_pipeline.cpp Huffman.cpp HuffmanTable.cpp Histogram.cpp Frame.cpp Lz77.cpp Fse.cpp Vigenere.cpp KeyStream.cpp -o clitool
     
     if [ $? -eq 0 ]; then
         echo "✓ Build successful!"
@@ -70,7 +73,7 @@ if [ "$MODE" == "cli" ]; then
 
 elif [ "$MODE" == "demo" ]; then
     echo "Building demo program..."
-    g++ -std=c++17 -O2 main.cpp Huffman.cpp -o demo
+    g++ -std=c++17 -O2 -pthread main.cpp cli_pipeline.cpp Huffman.cpp HuffmanTable.cpp Histogram.cpp Frame.cpp Lz77.cpp Fse.cpp Vigenere.cpp KeyStream.cpp -o demo
     
     if [ $? -eq 0 ]; then
         echo "✓ Build successful!"
@@ -79,19 +82,71 @@ elif [ "$MODE" == "demo" ]; then
         echo ""
         ./demo
         
-        if [ -f "uncompressed.txt" ]; then
-            echo ""
-            echo "Generated files:"
-            ls -lh freqTable.bin uncompressed.txt | awk '{print "   " $9 ": " $5}'
-        fi
     else
         echo "✗ Build failed!"
         exit 1
     fi
 
+elif [ "$MODE" == "microbench" ]; then
+    echo "Building microbenchmarks..."
+    g++ -std=c++17 -O2 -pthread microbench.cpp cli_pipeline.cpp Huffman.cpp HuffmanTable.cpp Histogram.cpp Frame.cpp Fse.cpp Lz77.cpp Vigenere.cpp KeyStream.cpp -o microbench
+
+    if [ $? -eq 0 ]; then
+        echo "✓ Build successful!"
+        echo ""
+        # ./run.sh microbench sweep [max_MiB] runs the per-kernel size sweep
+        shift
+        ./microbench "$@"
+    else
+        echo "✗ Build failed!"
+        exit 1
+    fi
+
+elif [ "$MODE" == "bench" ]; then
+    echo "Building end-to-end benchmark..."
+    g++ -std=c++17 -O2 -pthread bench.cpp cli_pipeline.cpp Huffman.cpp HuffmanTable.cpp Histogram.cpp Frame.cpp Lz77.cpp Fse.cpp Vigenere.cpp KeyStream.cpp -o bench
+
+    if [ $? -eq 0 ]; then
+        echo "✓ Build successful!"
+        echo ""
+        # Extra arguments go to the benchmark, e.g. ./run.sh bench --workers 1,8 --comp-alg fse
+        shift
+        ./bench --out bench.json "$@"
+        echo "Results written to bench.json"
+    else
+        echo "✗ Build failed!"
+        exit 1
+    fi
+
+elif [ "$MODE" == "large" ]; then
+    echo "Building CLI tool..."
+    g++ -std=c++17 -O2 -pthread cli_layout.cpp cli_pipeline.cpp Huffman.cpp HuffmanTable.cpp Histogram.cpp Frame.cpp Lz77.cpp Fse.cpp Vigenere.cpp KeyStream.cpp -o clitool
+    echo "✓ Build successful!"
+    echo ""
+
+    # 4.5 GiB sparse file with a few markers past the 4 GiB boundary
+    WORK=$(mktemp -d)
+    trap 'rm -rf "$WORK"' EXIT
+    truncate -s 4608M "$WORK/large.bin"
+    for OFF in 0 4095 4096 4500; do
+        echo "marker at ${OFF} MiB" | dd of="$WORK/large.bin" bs=1M seek=$OFF conv=notrunc status=none
+    done
+
+    echo "Compressing and encrypting $(du -h --apparent-size "$WORK/large.bin" | cut -f1) with --stream..."
+    ./clitool -ce --stream --comp-alg huffman --enc-alg xor -i "$WORK/large.bin" -o "$WORK/large" -k secret123
+    echo "Decrypting and decompressing..."
+    ./clitool -ud --stream --comp-alg huffman --enc-alg xor -i "$WORK/large.cmp.enc" -o "$WORK/restored.bin" -k secret123
+
+    if cmp "$WORK/large.bin" "$WORK/restored.bin"; then
+        echo "   ✓ Files match!"
+    else
+        echo "   ✗ Files differ!"
+        exit 1
+    fi
+
 else
     echo "Invalid option: $MODE"
-    echo "Use './run.sh cli' or './run.sh demo'"
+    echo "Use './run.sh cli', './run.sh demo', './run.sh microbench', './run.sh bench' or './run.sh large'"
     exit 1
 fi
 